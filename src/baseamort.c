@@ -1,81 +1,1071 @@
+#ifdef ORDMAIN_COMPACT
+/* for posix_memalign */
+#define _POSIX_C_SOURCE 200112L
+#endif
+
 #include <stdint.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h> // TODO: is this needed any more?
 #include <errno.h>
+#include <string.h>
+
+#include "order_maintenance.h"
+
+#ifdef NDEBUG
+
+#ifdef ORDMAIN_WIDE_TAGS
+typedef uint64_t tag_t;
+typedef uint32_t count_t;
+#else
+typedef uint32_t tag_t;
+typedef uint16_t count_t;
+typedef uint64_t sqtag_t;
+#endif
+
+#ifdef ORDMAIN_COMPACT
+typedef uint32_t index_t;
+
+struct ordmain_node {
+  tag_t tag;
+  /*
+    The positions of the neighbors in the node table of the list.
+   */
+  index_t prev;
+  index_t next;
+};
+#else
+struct ordmain_node {
+  tag_t tag;
+  /*
+    ${prev} is used only for delete and ordmain_insert_before.
+   */
+  struct ordmain_node * prev; 
+  struct ordmain_node * next;
+  struct ordmain_node * base;
+#ifdef ORDMAIN_RANK
+  /*
+    The place of the node in the treap kept for ordmain_rank, and the
+    number of nodes in its subtree.
+   */
+  struct ordmain_node * up;
+  struct ordmain_node * kid[2];
+  size_t weight;
+#endif
+};
+#endif
+
+#endif
+
+/*
+  Nodes are not allocated one at a time. Each list owns a set of
+  chunks, and nodes are carved from them in order, so that neighbors
+  in the list tend to be neighbors in memory. Deleted nodes go on a
+  per-list free list and are reused by later inserts. Memory is only
+  returned to malloc when the whole list is destroyed.
+
+  There are two layouts. By default, a node holds pointers to its
+  neighbors and to the base, and the base node is the first member of
+  struct ordmain_list, so the list a node belongs to is just x->base,
+  cast.
+
+  With ORDMAIN_COMPACT, a node holds only its tag and the indices of
+  its neighbors, which fits in 16 bytes even with wide tags. Chunks
+  are CHUNK_BYTES long and aligned to CHUNK_BYTES, so the header of the
+  chunk a node is in can be found by masking its address, and the
+  header points to the list and to the base. The list keeps a table of
+  its chunks to turn indices back into nodes. The base is always the
+  node at index 0.
+
+  The rest of the file only touches links through next_in, prev_in,
+  link and base_in, and only gets nodes through alloc_node, or
+  reserve followed by take.
+*/
+
+#define CACHE_LINE 64
+
+#ifdef ORDMAIN_COMPACT
+
+#define CHUNK_BYTES ((size_t)1 << 16)
+#define CHUNK_NODES ((CHUNK_BYTES - CACHE_LINE) / sizeof(struct ordmain_node))
+#define NO_INDEX ((index_t)~((index_t)0))
+
+/* A chunk header takes the first cache line of its chunk, and the
+   nodes fill the rest. */
+struct chunk {
+  struct ordmain_list * list;
+  struct ordmain_node * base;
+  /* The index of the first node in this chunk */
+  index_t first;
+};
+
+struct ordmain_list {
+  /* table[i] holds the nodes with indices from i * CHUNK_NODES up to
+     (i+1) * CHUNK_NODES */
+  struct chunk ** table;
+  size_t chunks;
+  size_t table_size;
+  /* Indices from ${fresh} up have never been handed out. */
+  index_t fresh;
+  /* The first of the nodes that were deleted, linked through ${next},
+     or NO_INDEX. */
+  index_t recycled;
+#ifdef ORDMAIN_CONCURRENT
+  unsigned seq;
+#endif
+#ifdef ORDMAIN_STATS
+  struct ordmain_stats stats;
+#endif
+};
+
+static struct chunk *
+chunk_of(const struct ordmain_node * const x) {
+  return (struct chunk *)((uintptr_t)x & ~((uintptr_t)CHUNK_BYTES - 1));
+}
+
+static struct ordmain_node *
+chunk_nodes(const struct chunk * const c) {
+  return (struct ordmain_node *)((char *)c + CACHE_LINE);
+}
+
+static struct ordmain_list *
+list_of(const struct ordmain_node * const x) {
+  return chunk_of(x)->list;
+}
+
+static struct ordmain_node *
+base_of(const struct ordmain_node * const x) {
+  return chunk_of(x)->base;
+}
+
+static struct ordmain_node *
+node_at(const struct ordmain_list * const l, const index_t i) {
+  return chunk_nodes(l->table[i / CHUNK_NODES]) + (i % CHUNK_NODES);
+}
+
+static index_t
+index_of(const struct ordmain_node * const x) {
+  const struct chunk * const c = chunk_of(x);
+  return c->first + (index_t)(x - chunk_nodes(c));
+}
+
+static struct ordmain_node *
+base_in(const struct ordmain_list * const l) {
+  return chunk_nodes(l->table[0]);
+}
+
+static struct ordmain_node *
+next_in(const struct ordmain_list * const l,
+        const struct ordmain_node * const x) {
+  return node_at(l, x->next);
+}
+
+static struct ordmain_node *
+prev_in(const struct ordmain_list * const l,
+        const struct ordmain_node * const x) {
+  return node_at(l, x->prev);
+}
+
+/* Makes y follow x. */
+static void
+link(const struct ordmain_list * const l, struct ordmain_node * const x,
+     struct ordmain_node * const y) {
+  (void)l;
+  x->next = index_of(y);
+  y->prev = index_of(x);
+}
+
+#else /* ORDMAIN_COMPACT */
+
+/* Chunks start small, so that short lists stay cheap, and double in
+   size up to MAX_CHUNK_NODES. */
+#define MIN_CHUNK_NODES 16
+#define MAX_CHUNK_NODES 4096
+
+/* A chunk header is followed by its nodes, which start at the first
+   cache line boundary after the header. */
+struct chunk {
+  struct chunk * next;
+};
+
+struct ordmain_list {
+  struct ordmain_node base;
+  struct chunk * chunks;
+  /* Nodes in [fresh, limit) have never been handed out. */
+  struct ordmain_node * fresh;
+  struct ordmain_node * limit;
+  /* Nodes that were deleted, linked through ${next}. */
+  struct ordmain_node * recycled;
+  size_t next_chunk_nodes;
+#ifdef ORDMAIN_RANK
+  /* The root of the treap of the nodes other than the base */
+  struct ordmain_node * top;
+#endif
+#ifdef ORDMAIN_CONCURRENT
+  unsigned seq;
+#endif
+#ifdef ORDMAIN_STATS
+  struct ordmain_stats stats;
+#endif
+};
+
+static struct ordmain_list *
+list_of(const struct ordmain_node * const x) {
+  return (struct ordmain_list *)(x->base);
+}
+
+static struct ordmain_node *
+base_of(const struct ordmain_node * const x) {
+  return x->base;
+}
+
+static struct ordmain_node *
+base_in(struct ordmain_list * const l) {
+  return &l->base;
+}
+
+static struct ordmain_node *
+next_in(const struct ordmain_list * const l,
+        const struct ordmain_node * const x) {
+  (void)l;
+  return x->next;
+}
+
+static struct ordmain_node *
+prev_in(const struct ordmain_list * const l,
+        const struct ordmain_node * const x) {
+  (void)l;
+  return x->prev;
+}
+
+/* Makes y follow x. */
+static void
+link(const struct ordmain_list * const l, struct ordmain_node * const x,
+     struct ordmain_node * const y) {
+  (void)l;
+  x->next = y;
+  y->prev = x;
+}
+
+#endif /* ORDMAIN_COMPACT */
+
+/*
+  STAT(statement) runs statement only in builds with ORDMAIN_STATS
+  defined, so that the counters cost nothing otherwise.
+*/
+#ifdef ORDMAIN_STATS
+#define STAT(statement) statement
+
+/*
+  Records that one insert relabeled ${many} existing nodes.
+*/
+static void
+count_relabel(struct ordmain_list * const l, const count_t many) {
+  unsigned bucket = 0;
+  for (count_t m = many; 0 != m; m >>= 1) {
+    ++bucket;
+  }
+  assert (bucket < ORDMAIN_STATS_BUCKETS);
+  ++l->stats.relabel_histogram[bucket];
+  l->stats.relabeled += many;
+  if (many > l->stats.max_relabel) {
+    l->stats.max_relabel = many;
+  }
+}
+#else
+#define STAT(statement)
+#endif
+
+/*
+  Concurrent readers.
+
+  With ORDMAIN_CONCURRENT defined, one thread may insert into or
+  delete from a list while any number of other threads call
+  ordmain_in_order or ordmain_in_order_batch on nodes of that list
+  that are not being deleted. Everything else still needs the list to
+  itself.
+
+  Queries only read tags, and the only tags a writer changes in nodes
+  that readers can see are the ones it relabels. So each list has a
+  sequence counter, which is odd exactly while a relabel is in
+  progress. A reader reads the counter, then the tags, then the
+  counter again, and retries if the counter was odd or changed. Tags
+  that can be read and written at the same time are only accessed
+  through relaxed atomics, and the counter through the fences of
+  Boehm's seqlock, so that there is no data race under the C11 memory
+  model. The library is C99, so this uses the GCC __atomic builtins,
+  which follow that model.
+
+  Without ORDMAIN_CONCURRENT, all of these compile to plain loads and
+  stores.
+*/
+#ifdef ORDMAIN_CONCURRENT
+#ifndef __GNUC__
+#error "ORDMAIN_CONCURRENT needs the GCC __atomic builtins"
+#endif
+
+static tag_t
+load_tag(const struct ordmain_node * const x) {
+  return __atomic_load_n(&x->tag, __ATOMIC_RELAXED);
+}
+
+static void
+store_tag(struct ordmain_node * const x, const tag_t t) {
+  __atomic_store_n(&x->tag, t, __ATOMIC_RELAXED);
+}
+
+/* Called by the writer before relabeling nodes in ${l}. */
+static void
+write_begin(struct ordmain_list * const l) {
+  assert (0 == (l->seq & 1));
+  __atomic_store_n(&l->seq, l->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/* Called by the writer when the relabel is done. */
+static void
+write_end(struct ordmain_list * const l) {
+  assert (1 == (l->seq & 1));
+  __atomic_store_n(&l->seq, l->seq + 1, __ATOMIC_RELEASE);
+}
+
+/* Returns the counter to pass to read_retry, once no relabel is in
+   progress. */
+static unsigned
+read_begin(const struct ordmain_list * const l) {
+  unsigned ans = __atomic_load_n(&l->seq, __ATOMIC_ACQUIRE);
+  while (0 != (ans & 1)) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+    ans = __atomic_load_n(&l->seq, __ATOMIC_ACQUIRE);
+  }
+  return ans;
+}
+
+/* Did a relabel overlap the reads since read_begin returned ${seq}? */
+static bool
+read_retry(const struct ordmain_list * const l, const unsigned seq) {
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return seq != __atomic_load_n(&l->seq, __ATOMIC_RELAXED);
+}
+
+#else /* ORDMAIN_CONCURRENT */
+
+static tag_t
+load_tag(const struct ordmain_node * const x) {
+  return x->tag;
+}
+
+static void
+store_tag(struct ordmain_node * const x, const tag_t t) {
+  x->tag = t;
+}
+
+static void
+write_begin(struct ordmain_list * const l) {
+  (void)l;
+}
+
+static void
+write_end(struct ordmain_list * const l) {
+  (void)l;
+}
+
+static unsigned
+read_begin(const struct ordmain_list * const l) {
+  (void)l;
+  return 0;
+}
+
+static bool
+read_retry(const struct ordmain_list * const l, const unsigned seq) {
+  (void)l;
+  (void)seq;
+  return false;
+}
+
+#endif /* ORDMAIN_CONCURRENT */
+
+#ifdef ORDMAIN_STATS
+/* Readers may count queries at the same time. */
+static void
+count_queries(struct ordmain_list * const l, const size_t many) {
+#ifdef ORDMAIN_CONCURRENT
+  __atomic_fetch_add(&l->stats.queries, (uint64_t)many, __ATOMIC_RELAXED);
+#else
+  l->stats.queries += many;
+#endif
+}
+#endif
+
+#ifdef ORDMAIN_COMPACT
+
+/*
+  Appends a chunk to the table of the list. Returns false if
+  allocation fails.
+*/
+static bool
+add_chunk(struct ordmain_list * const l) {
+  if (l->chunks == l->table_size) {
+    const size_t size = (0 == l->table_size) ? 4 : 2 * l->table_size;
+    struct chunk ** const table = realloc(l->table, size * sizeof(*table));
+    if (NULL == table) {
+      return false;
+    }
+    STAT(l->stats.bytes += (size - l->table_size) * sizeof(*table));
+    l->table = table;
+    l->table_size = size;
+  }
+  void * raw = NULL;
+  if (0 != posix_memalign(&raw, CHUNK_BYTES, CHUNK_BYTES)) {
+    return false;
+  }
+  STAT(l->stats.bytes += CHUNK_BYTES);
+  struct chunk * const c = raw;
+  c->list = l;
+  c->base = (0 == l->chunks) ? chunk_nodes(c) : base_in(l);
+  c->first = (index_t)(l->chunks * CHUNK_NODES);
+  l->table[l->chunks] = c;
+  ++l->chunks;
+  return true;
+}
+
+/*
+  Makes sure that the next ${many} calls to take will succeed. Returns
+  false on error.
+*/
+static bool
+reserve(struct ordmain_list * const l, const size_t many) {
+  if (many >= (size_t)(NO_INDEX - l->fresh)) {
+    return false;
+  }
+  while (l->chunks * CHUNK_NODES < l->fresh + many) {
+    if (!add_chunk(l)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+  Returns the next fresh node. Consecutive calls return consecutive
+  indices, which are adjacent in memory except at chunk boundaries.
+*/
+static struct ordmain_node *
+take(struct ordmain_list * const l) {
+  assert (l->fresh < l->chunks * CHUNK_NODES);
+  return node_at(l, l->fresh++);
+}
+
+/*
+  Takes the next ${n} fresh nodes, which reserve has made room for,
+  stores them in out, and tags them step, 2 * step, and so on. Each is
+  linked to the nodes taken just before and after it, except that the
+  first and last are left for the caller to link. Every node is
+  written from its own position alone, so within a chunk the loop
+  carries no dependence from one node to the next.
+*/
+static void
+take_run(struct ordmain_list * const l, const size_t n, const tag_t step,
+         struct ordmain_node * out[]) {
+  const index_t first = l->fresh;
+  assert (n <= l->chunks * CHUNK_NODES - first);
+  l->fresh += (index_t)n;
+  size_t i = 0;
+  while (i < n) {
+    const index_t at = first + (index_t)i;
+    struct ordmain_node * const run = node_at(l, at);
+    const size_t room = CHUNK_NODES - at % CHUNK_NODES;
+    const size_t end = (n - i < room) ? n : i + room;
+    for (size_t k = i; k < end; ++k) {
+      struct ordmain_node * const h = run + (k - i);
+      h->tag = ((tag_t)(k+1)) * step;
+      h->prev = first + (index_t)k - 1;
+      h->next = first + (index_t)k + 1;
+      out[k] = h;
+    }
+    i = end;
+  }
+}
+
+/*
+  Returns an uninitialized node from the list ${l}, or NULL on error.
+*/
+static struct ordmain_node *
+alloc_node(struct ordmain_list * const l) {
+  if (NO_INDEX != l->recycled) {
+    struct ordmain_node * const ans = node_at(l, l->recycled);
+    l->recycled = ans->next;
+    return ans;
+  }
+  if (!reserve(l, 1)) {
+    return NULL;
+  }
+  return take(l);
+}
+
+static void
+destroy(struct ordmain_node * const x) {
+  struct ordmain_list * const l = list_of(x);
+#ifndef NDEBUG
+  x->prev = NO_INDEX;
+#endif /* NDEBUG */
+  x->next = l->recycled;
+  l->recycled = index_of(x);
+  return;
+}
+
+/*
+  Frees every chunk of the list, then the list itself.
+*/
+static void
+destroy_list(struct ordmain_list * const l) {
+  for (size_t i = 0; i < l->chunks; ++i) {
+    free(l->table[i]);
+  }
+  free(l->table);
+  free(l);
+}
+
+/* 
+make_base(void):
+Creates an empty list and returns a pointer to the base ordmain_node.
+Returns NULL on error.
+*/
+static struct ordmain_node * 
+make_base() {
+  struct ordmain_list * const l = malloc(sizeof(struct ordmain_list));
+  if (NULL == l) {
+    return NULL;
+  }
+  l->table = NULL;
+  l->chunks = 0;
+  l->table_size = 0;
+  l->fresh = 0;
+  l->recycled = NO_INDEX;
+#ifdef ORDMAIN_CONCURRENT
+  l->seq = 0;
+#endif
+#ifdef ORDMAIN_STATS
+  const struct ordmain_stats zero = {0};
+  l->stats = zero;
+  l->stats.bytes = sizeof(struct ordmain_list);
+#endif
+  if (!reserve(l, 1)) {
+    destroy_list(l);
+    return NULL;
+  }
+  struct ordmain_node * const h = take(l);
+  assert (h == base_in(l));
+  h->tag = 0;
+  link(l, h, h);
+  return h;
+}
+
+#else /* ORDMAIN_COMPACT */
+
+/*
+  Adds a chunk with room for at least ${many} nodes to the list and
+  makes it the source of fresh nodes. Any fresh nodes left in the old
+  chunk are moved to the free list. Returns false if malloc fails.
+*/
+static bool
+grow(struct ordmain_list * const l, const size_t many) {
+  size_t capacity = l->next_chunk_nodes;
+  if (capacity < many) {
+    capacity = many;
+  } else if (l->next_chunk_nodes < MAX_CHUNK_NODES) {
+    l->next_chunk_nodes *= 2;
+  }
+  if (capacity > (SIZE_MAX - sizeof(struct chunk) - CACHE_LINE)
+      / sizeof(struct ordmain_node)) {
+    return false;
+  }
+  const size_t bytes = sizeof(struct chunk) + CACHE_LINE - 1
+    + capacity * sizeof(struct ordmain_node);
+  void * const raw = malloc(bytes);
+  if (NULL == raw) {
+    return false;
+  }
+  STAT(l->stats.bytes += bytes);
+  struct chunk * const c = raw;
+  c->next = l->chunks;
+  l->chunks = c;
+
+  uintptr_t start = (uintptr_t)(c + 1);
+  start = (start + CACHE_LINE - 1) & ~((uintptr_t)CACHE_LINE - 1);
+
+  while (l->fresh != l->limit) {
+    l->fresh->next = l->recycled;
+    l->recycled = l->fresh;
+    ++l->fresh;
+  }
+  l->fresh = (struct ordmain_node *)start;
+  l->limit = l->fresh + capacity;
+  return true;
+}
+
+/*
+  Makes sure that the next ${many} calls to take will succeed, and
+  return nodes that are contiguous in memory. Returns false on error.
+*/
+static bool
+reserve(struct ordmain_list * const l, const size_t many) {
+  return ((size_t)(l->limit - l->fresh) >= many) || grow(l, many);
+}
+
+/*
+  Returns the next fresh node.
+*/
+static struct ordmain_node *
+take(struct ordmain_list * const l) {
+  assert (l->fresh < l->limit);
+  struct ordmain_node * const ans = l->fresh++;
+  ans->base = &l->base;
+  return ans;
+}
+
+/*
+  Takes the next ${n} fresh nodes, which reserve has made contiguous,
+  stores them in out, and tags them step, 2 * step, and so on. Each is
+  linked to the nodes taken just before and after it, except that the
+  first and last are left for the caller to link. Every node is
+  written from its own position alone, so the loops carry no
+  dependence from one node to the next.
+*/
+static void
+take_run(struct ordmain_list * const l, const size_t n, const tag_t step,
+         struct ordmain_node * out[]) {
+  struct ordmain_node * const run = l->fresh;
+  assert (n <= (size_t)(l->limit - run));
+  l->fresh += n;
+  for (size_t k = 0; k < n; ++k) {
+    run[k].tag = ((tag_t)(k+1)) * step;
+    run[k].base = &l->base;
+    run[k].next = run + k + 1;
+    out[k] = run + k;
+  }
+  for (size_t k = 1; k < n; ++k) {
+    run[k].prev = run + k - 1;
+  }
+}
+
+/*
+  Returns an uninitialized node from the list ${l}, or NULL on error.
+*/
+static struct ordmain_node *
+alloc_node(struct ordmain_list * const l) {
+  if (NULL != l->recycled) {
+    struct ordmain_node * const ans = l->recycled;
+    l->recycled = ans->next;
+    ans->base = &l->base;
+    return ans;
+  }
+  if (!reserve(l, 1)) {
+    return NULL;
+  }
+  return take(l);
+}
+
+static void
+destroy(struct ordmain_node * const x) {
+  struct ordmain_list * const l = list_of(x);
+  /* Unset base members to assist in catching memory errors. */
+#ifndef NDEBUG
+  x->base = NULL;
+  x->prev = NULL;
+#endif /* NDEBUG */
+  x->next = l->recycled;
+  l->recycled = x;
+  return;
+}
+
+/*
+  Frees every chunk of the list, then the list itself.
+*/
+static void
+destroy_list(struct ordmain_list * const l) {
+  struct chunk * c = l->chunks;
+  while (NULL != c) {
+    struct chunk * const next = c->next;
+    free(c);
+    c = next;
+  }
+#ifndef NDEBUG
+  l->base.base = NULL;
+  l->base.prev = NULL;
+  l->base.next = NULL;
+#endif /* NDEBUG */
+  free(l);
+}
+
+/* 
+make_base(void):
+Creates an empty list and returns a pointer to the base ordmain_node.
+Returns NULL on error.
+*/
+static struct ordmain_node * 
+make_base() {
+  struct ordmain_list * const l = malloc(sizeof(struct ordmain_list));
+  if (NULL == l) {
+    return NULL;
+  }
+  l->chunks = NULL;
+  l->fresh = NULL;
+  l->limit = NULL;
+  l->recycled = NULL;
+#ifdef ORDMAIN_CONCURRENT
+  l->seq = 0;
+#endif
+  l->next_chunk_nodes = MIN_CHUNK_NODES;
+#ifdef ORDMAIN_RANK
+  l->top = NULL;
+#endif
+#ifdef ORDMAIN_STATS
+  const struct ordmain_stats zero = {0};
+  l->stats = zero;
+  l->stats.bytes = sizeof(struct ordmain_list);
+#endif
+  struct ordmain_node * const h = &l->base;
+  h->tag = 0;
+  h->base = h;
+  link(l, h, h);
+  return h;
+}
+
+#endif /* ORDMAIN_COMPACT */
+
+/*
+  Ranks.
+
+  With ORDMAIN_RANK defined, the nodes of each list other than the
+  base are also kept in a treap in list order, and each node holds the
+  number of nodes in its subtree. The rank of a node is then the
+  number of nodes in left subtrees along its path to the root. Tags
+  play no part in the treap, so relabels leave it alone.
+
+  A node's priority is a hash of its address, so it takes no space.
+  A single new node goes in as a leaf next to x, and is rotated up
+  past parents of lower priority. Deletes merge the two children of x
+  into its place. Both take O(log n) expected time, mostly to fix the
+  weights on the path to the root. A run of new nodes is made into a
+  treap of its own, left to right along its right spine, in time
+  linear in its length, and then merged in between the two halves of
+  the treap split just after x. That is how ordmain_build stays O(n).
+*/
+#ifdef ORDMAIN_RANK
+#ifdef ORDMAIN_COMPACT
+#error "ORDMAIN_RANK does not fit in the nodes of ORDMAIN_COMPACT"
+#endif
+
+/* The 64-bit finalizer of MurmurHash3, which is a bijection, so no
+   two nodes have the same priority. */
+static uint64_t
+priority(const struct ordmain_node * const x) {
+  uint64_t z = (uint64_t)(uintptr_t)x;
+  z ^= z >> 33;
+  z *= UINT64_C(0xff51afd7ed558ccd);
+  z ^= z >> 33;
+  z *= UINT64_C(0xc4ceb9fe1a85ec53);
+  z ^= z >> 33;
+  return z;
+}
+
+static size_t
+weight_of(const struct ordmain_node * const x) {
+  return (NULL == x) ? 0 : x->weight;
+}
+
+/* Recomputes the weight of ${x} from its children. */
+static void
+fix(struct ordmain_node * const x) {
+  x->weight = 1 + weight_of(x->kid[0]) + weight_of(x->kid[1]);
+}
+
+static void
+set_kid(struct ordmain_node * const x, const int side,
+        struct ordmain_node * const y) {
+  x->kid[side] = y;
+  if (NULL != y) {
+    y->up = x;
+  }
+}
+
+static void
+set_top(struct ordmain_list * const l, struct ordmain_node * const x) {
+  l->top = x;
+  if (NULL != x) {
+    x->up = NULL;
+  }
+}
+
+/* Returns the number of nodes before ${x} in its list. */
+static size_t
+rank(const struct ordmain_node * const x) {
+  size_t ans = weight_of(x->kid[0]);
+  for (const struct ordmain_node * c = x, * p = x->up; NULL != p;
+       c = p, p = p->up) {
+    if (p->kid[1] == c) {
+      ans += weight_of(p->kid[0]) + 1;
+    }
+  }
+  return ans;
+}
+
+/*
+  Returns the root of a treap holding the nodes of ${a} followed by
+  the nodes of ${b}. The up pointer of the root is left for the caller
+  to set.
+*/
+static struct ordmain_node *
+merge(struct ordmain_node * const a, struct ordmain_node * const b) {
+  if (NULL == a) {
+    return b;
+  }
+  if (NULL == b) {
+    return a;
+  }
+  if (priority(a) > priority(b)) {
+    set_kid(a, 1, merge(a->kid[1], b));
+    fix(a);
+    return a;
+  }
+  set_kid(b, 0, merge(a, b->kid[0]));
+  fix(b);
+  return b;
+}
+
+/*
+  Splits the treap ${t} into the treaps *lo, of its first ${k} nodes,
+  and *hi, of the rest. As with merge, the up pointers of the two roots
+  are left for the caller to set.
+*/
+static void
+split(struct ordmain_node * const t, const size_t k,
+      struct ordmain_node ** const lo, struct ordmain_node ** const hi) {
+  if (NULL == t) {
+    assert (0 == k);
+    *lo = NULL;
+    *hi = NULL;
+    return;
+  }
+  const size_t left = weight_of(t->kid[0]);
+  struct ordmain_node * rest;
+  if (k <= left) {
+    split(t->kid[0], k, lo, &rest);
+    set_kid(t, 0, rest);
+    fix(t);
+    *hi = t;
+  } else {
+    split(t->kid[1], k - left - 1, &rest, hi);
+    set_kid(t, 1, rest);
+    fix(t);
+    *lo = t;
+  }
+}
+
+/*
+  Returns the root of a treap of the ${n} nodes that follow ${x} in the
+  list. The last node placed is always at the bottom of the right
+  spine, and each new node climbs the spine past the nodes of lower
+  priority, which are then finished and become its left subtree.
+*/
+static struct ordmain_node *
+treap_of_run(const struct ordmain_list * const l,
+             const struct ordmain_node * x, const size_t n) {
+  struct ordmain_node * spine = NULL;
+  for (size_t i = 0; i < n; ++i) {
+    struct ordmain_node * const h = next_in(l, x);
+    struct ordmain_node * below = NULL;
+    while ((NULL != spine) && (priority(spine) < priority(h))) {
+      fix(spine);
+      below = spine;
+      spine = spine->up;
+    }
+    set_kid(h, 0, below);
+    h->kid[1] = NULL;
+    h->up = spine;
+    if (NULL != spine) {
+      spine->kid[1] = h;
+    }
+    spine = h;
+    x = h;
+  }
+  struct ordmain_node * top = NULL;
+  while (NULL != spine) {
+    fix(spine);
+    top = spine;
+    spine = spine->up;
+  }
+  return top;
+}
+
+/*
+  Swaps ${x} with its parent, keeping the order of the nodes.
+*/
+static void
+rotate_up(struct ordmain_list * const l, struct ordmain_node * const x) {
+  struct ordmain_node * const p = x->up;
+  struct ordmain_node * const g = p->up;
+  const int side = (p->kid[1] == x);
+  set_kid(p, side, x->kid[!side]);
+  set_kid(x, !side, p);
+  fix(p);
+  fix(x);
+  if (NULL == g) {
+    set_top(l, x);
+  } else {
+    set_kid(g, g->kid[1] == p, x);
+  }
+}
+
+/*
+  Adds the node just linked in after ${x} to the treap of ${l}, as
+  the leftmost node of the right subtree of ${x}.
+*/
+static void
+rank_insert_one(struct ordmain_list * const l, struct ordmain_node * const x) {
+  struct ordmain_node * const h = next_in(l, x);
+  h->kid[0] = NULL;
+  h->kid[1] = NULL;
+  h->weight = 1;
+  struct ordmain_node * p = (base_in(l) == x) ? l->top : x->kid[1];
+  if (NULL == p) {
+    if (base_in(l) == x) {
+      set_top(l, h);
+      return;
+    }
+    set_kid(x, 1, h);
+  } else {
+    while (NULL != p->kid[0]) {
+      p = p->kid[0];
+    }
+    set_kid(p, 0, h);
+  }
+  for (struct ordmain_node * q = h->up; NULL != q; q = q->up) {
+    ++q->weight;
+  }
+  while ((NULL != h->up) && (priority(h->up) < priority(h))) {
+    rotate_up(l, h);
+  }
+}
 
-#include "order_maintenance.h"
+/*
+  Adds the ${n} nodes just linked in after ${x} to the treap of ${l}.
+*/
+static void
+rank_insert(struct ordmain_list * const l, struct ordmain_node * const x,
+            const size_t n) {
+  if (1 == n) {
+    rank_insert_one(l, x);
+    return;
+  }
+  struct ordmain_node * const run = treap_of_run(l, x, n);
+  const size_t k = (base_in(l) == x) ? 0 : rank(x) + 1;
+  struct ordmain_node * lo;
+  struct ordmain_node * hi;
+  split(l->top, k, &lo, &hi);
+  set_top(l, merge(merge(lo, run), hi));
+}
 
-#ifdef NDEBUG
+/*
+  Removes ${x} from the treap of ${l}.
+*/
+static void
+rank_delete(struct ordmain_list * const l, struct ordmain_node * const x) {
+  struct ordmain_node * const p = x->up;
+  struct ordmain_node * const c = merge(x->kid[0], x->kid[1]);
+  if (NULL == p) {
+    set_top(l, c);
+    return;
+  }
+  set_kid(p, p->kid[1] == x, c);
+  for (struct ordmain_node * q = p; NULL != q; q = q->up) {
+    --q->weight;
+  }
+}
 
-typedef uint32_t tag_t;
-typedef uint16_t count_t;
-typedef uint64_t sqtag_t;
+#else /* ORDMAIN_RANK */
 
-struct ordmain_node {
-  tag_t tag;
-  /*
-    ${prev} is used only for delete and ordmain_insert_before.
-   */
-  struct ordmain_node * prev; 
-  struct ordmain_node * next;
-  struct ordmain_node * base;
-};
+static void
+rank_insert(struct ordmain_list * const l, struct ordmain_node * const x,
+            const size_t n) {
+  (void)l;
+  (void)x;
+  (void)n;
+}
 
-#endif
+static void
+rank_delete(struct ordmain_list * const l, struct ordmain_node * const x) {
+  (void)l;
+  (void)x;
+}
 
-/* 
-make_base(void):
-Creates an empty list and returns a pointer to the base ordmain_node.
-Returns NULL on error.
+#endif /* ORDMAIN_RANK */
+
+/*
+  spread(w, k, j):
+
+  Returns floor(w * k / j), for 0 < k < j. This is the offset from the
+  start of a gap of width w at which the k-th of j-1 evenly spaced
+  nodes goes.
+
+  The product w * k does not fit in a tag_t. With narrow tags it is
+  computed in a sqtag_t. With wide tags there is no portable integer
+  type twice as wide, so the quotient is split as w = q * j + r. Then
+  w * k / j = q * k + r * k / j exactly, and since r < j and k < j,
+  neither q * k nor r * k can overflow as long as count_t is at most
+  half as wide as tag_t.
 */
-static struct ordmain_node * 
-make_base() {
-  struct ordmain_node * const h = malloc(sizeof(struct ordmain_node));
-  if (NULL == h) {
-    return NULL;
-  }
-  h->tag = 0;
-  h->prev = h;
-  h->next = h;
-  h->base = h;
-  return h;
+static tag_t
+spread(const tag_t w, const count_t k, const count_t j) {
+  assert (0 < k);
+  assert (k < j);
+#ifdef ORDMAIN_WIDE_TAGS
+  const tag_t q = w / j;
+  const tag_t r = w % j;
+  return q * k + (r * k) / j;
+#else
+  return (((sqtag_t)w) * ((sqtag_t)k)) / ((sqtag_t)j);
+#endif
 }
 
 // Returns a finger to a struct ordmain_node one past the struct ordmain_node pointed to by the finger xf
 struct ordmain_node * 
 ordmain_insert_after(struct ordmain_node * x) {
-  if (NULL == x) {
+  const bool new_list = (NULL == x);
+  if (new_list) {
     x = make_base();
   }
   if (NULL == x) {
     return NULL;
   }
   assert (NULL != x);
-  assert (NULL != x->next);
+  struct ordmain_list * const l = list_of(x);
 
   // The struct ordmain_node h will be the answer we eventually return
-  struct ordmain_node * h = malloc(sizeof(struct ordmain_node));
+  struct ordmain_node * h = alloc_node(l);
   if (NULL == h) {
     // malloc has failed
-    free(x);
+    if (new_list) {
+      destroy_list(l);
+    }
     return NULL;
   }
-  // Set up the struct ordmain_node so that it will be valid once its new neighbors point to it:
-  h->prev = x;
-  h->next = x->next;
-  h->base = x->base;
+  STAT(++l->stats.inserts);
 
   // if we are inserting into an empty list
-  if (x->next == x) {
-    x->next = h;
-    x->prev = h;
+  if (next_in(l, x) == x) {
+    link(l, x, h);
+    link(l, h, x);
     h->tag = (~0) >> 1;
+    rank_insert(l, x, 1);
     return h;
   }
 
   count_t j = 1;
-  struct ordmain_node * xj = x->next;
+  struct ordmain_node * xj = next_in(l, x);
   assert (xj != x);
   tag_t wj = xj->tag - x->tag;
   assert (0 != wj);
@@ -86,7 +1076,7 @@ ordmain_insert_after(struct ordmain_node * x) {
     /* Since j started as 1, if 0 == j, j has wrapped around, and the
        structure is actually full. */
     assert (0 != j);
-    xj = xj->next;
+    xj = next_in(l, xj);
     assert (NULL != xj);
     wj = xj->tag - x->tag;
     if (0 == wj) { // gone around
@@ -98,29 +1088,187 @@ ordmain_insert_after(struct ordmain_node * x) {
 
   /* reset the tags of j-1 struct ordmain_nodes by evenly spacing them
    */
-  struct ordmain_node * xk = x->next;
+  struct ordmain_node * xk = next_in(l, x);
+  if (1 < j) {
+    write_begin(l);
+  }
   for (count_t k = 1; k < j; ++k) {
-    const sqtag_t p = ((sqtag_t)wj) * ((sqtag_t)k);
-    const sqtag_t pret = p / ((sqtag_t)j) + (sqtag_t)(x->tag);
     assert (NULL != xk);
-    xk->tag = pret & ((sqtag_t)(~((tag_t)0)));
-    assert (xk->tag != xk->prev->tag);
-    assert (xk->tag != 1+(xk->prev->tag));
-    xk = xk->next;
+    store_tag(xk, x->tag + spread(wj, k, j));
+    assert (xk->tag != prev_in(l, xk)->tag);
+    assert (xk->tag != 1+(prev_in(l, xk)->tag));
+    xk = next_in(l, xk);
+  }
+  if (1 < j) {
+    write_end(l);
   }
-  assert (NULL != x->next);
-  const tag_t nt = x->tag + (x->next->tag - x->tag)/2;
+  struct ordmain_node * const after = next_in(l, x);
+  const tag_t nt = x->tag + (after->tag - x->tag)/2;
   assert (nt != x->tag);
-  assert (nt != x->next->tag);
+  assert (nt != after->tag);
   h->tag = nt;
-  x->next->prev = h;
-  x->next = h;
+  link(l, h, after);
+  link(l, x, h);
+  rank_insert(l, x, 1);
+  STAT(count_relabel(l, j-1));
   return h;
 }
 
 struct ordmain_node * 
 ordmain_insert_before(struct ordmain_node * x) {
-  return ordmain_insert_after(x->prev);
+  return ordmain_insert_after(prev_in(list_of(x), x));
+}
+
+#define TAG_MAX ((tag_t)~((tag_t)0))
+#define COUNT_MAX ((count_t)~((count_t)0))
+
+/*
+  Returns m * m, or TAG_MAX if that would overflow.
+*/
+static tag_t
+square_or_max(const tag_t m) {
+  const tag_t root_max = TAG_MAX >> (sizeof(tag_t) << 2);
+  if (m > root_max) {
+    return TAG_MAX;
+  }
+  return m * m;
+}
+
+/*
+  This is ordmain_insert_after with the scan generalized to n new
+  nodes. Walking from x, it stops at the first xj such that the j-1
+  old nodes and the n new ones fit with the same density bound as a
+  single insert: the gap wj must exceed (j+n-1)^2. The old and new
+  nodes are then given evenly spaced tags in one pass, new nodes
+  first.
+*/
+int
+ordmain_insert_n_after(struct ordmain_node * x, const size_t n,
+                       struct ordmain_node * out[]) {
+  if (0 == n) {
+    return 0;
+  }
+  if (n >= COUNT_MAX) {
+    errno = ENOSPC;
+    return -1;
+  }
+  const bool new_list = (NULL == x);
+  if (new_list) {
+    x = make_base();
+  }
+  if (NULL == x) {
+    errno = ENOMEM;
+    return -1;
+  }
+  struct ordmain_list * const l = list_of(x);
+
+  count_t j = 1;
+  struct ordmain_node * xj = next_in(l, x);
+  tag_t wj = xj->tag - x->tag;
+  if (xj == x) {
+    wj = ~0;
+  } else {
+    while (wj <= square_or_max(((tag_t)j) + ((tag_t)n) - 1)) {
+      if (((count_t)(COUNT_MAX - n)) == j) {
+        break;
+      }
+      ++j;
+      xj = next_in(l, xj);
+      assert (NULL != xj);
+      wj = xj->tag - x->tag;
+      if (0 == wj) { // gone around
+        wj = ~0;
+        break;
+      }
+    }
+  }
+  /* j+n-1 nodes need distinct tags strictly inside the gap */
+  const count_t many = j + (count_t)n;
+  if (wj < (tag_t)many) {
+    if (new_list) {
+      destroy_list(l);
+    }
+    errno = ENOSPC;
+    return -1;
+  }
+  if (!reserve(l, n)) {
+    if (new_list) {
+      destroy_list(l);
+    }
+    errno = ENOMEM;
+    return -1;
+  }
+
+  struct ordmain_node * xk = next_in(l, x);
+  if (1 < j) {
+    write_begin(l);
+  }
+  for (count_t k = (count_t)n + 1; k < many; ++k) {
+    assert (xk != x);
+    store_tag(xk, x->tag + spread(wj, k, many));
+    xk = next_in(l, xk);
+  }
+  if (1 < j) {
+    write_end(l);
+  }
+  struct ordmain_node * const after = next_in(l, x);
+  struct ordmain_node * prev = x;
+  for (size_t i = 0; i < n; ++i) {
+    struct ordmain_node * const h = take(l);
+    h->tag = x->tag + spread(wj, (count_t)(i+1), many);
+    link(l, prev, h);
+    if (NULL != out) {
+      out[i] = h;
+    }
+    prev = h;
+  }
+  link(l, prev, after);
+  rank_insert(l, x, n);
+  STAT(l->stats.inserts += n);
+  STAT(count_relabel(l, j-1));
+  return 0;
+}
+
+/*
+  The tags are multiples of a single step, which is as large as
+  possible while still fitting n of them after the base. The nodes are
+  one reserved run, so take_run can write each node's tag and links
+  from its position alone, with no chain from one node to the next,
+  and only the two ends are then linked to the base.
+*/
+int
+ordmain_build(const size_t n, struct ordmain_node * out[]) {
+  if (NULL == out) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (0 == n) {
+    return 0;
+  }
+  if (n >= COUNT_MAX) {
+    errno = ENOSPC;
+    return -1;
+  }
+  struct ordmain_node * const base = make_base();
+  if (NULL == base) {
+    errno = ENOMEM;
+    return -1;
+  }
+  struct ordmain_list * const l = list_of(base);
+  if (!reserve(l, n)) {
+    destroy_list(l);
+    errno = ENOMEM;
+    return -1;
+  }
+  const tag_t step = TAG_MAX / (((tag_t)n) + 1);
+  assert (0 != step);
+
+  take_run(l, n, step, out);
+  link(l, base, out[0]);
+  link(l, out[n-1], base);
+  rank_insert(l, base, n);
+  STAT(l->stats.inserts += n);
+  return 0;
 }
 
 /*
@@ -139,16 +1287,25 @@ static int
 order(const struct ordmain_node * const x, const struct ordmain_node * const y) {
   if ((NULL == x)
       || (NULL == y)
-      || (x->base != y->base)) {
+      || (base_of(x) != base_of(y))) {
     errno = EINVAL; // TODO: is this the right errno?
     return -2;
   }
   // broken nodes:
-  assert (NULL != x->base);
-  assert (NULL != y->base);
+  assert (NULL != base_of(x));
+  assert (NULL != base_of(y));
   
-  const tag_t xtag = x->tag - x->base->tag;
-  const tag_t ytag = y->tag - y->base->tag;
+  const struct ordmain_list * const l = list_of(x);
+  const struct ordmain_node * const base = base_of(x);
+  tag_t xtag;
+  tag_t ytag;
+  unsigned seq;
+  do {
+    seq = read_begin(l);
+    const tag_t base_tag = load_tag(base);
+    xtag = load_tag(x) - base_tag;
+    ytag = load_tag(y) - base_tag;
+  } while (read_retry(l, seq));
 
   if (xtag > ytag) {
     return 1;
@@ -162,37 +1319,494 @@ order(const struct ordmain_node * const x, const struct ordmain_node * const y)
 }
 
 bool ordmain_in_order(const struct ordmain_node * x, const struct ordmain_node * y) {
+  STAT(if (NULL != x) { count_queries(list_of(x), 1); });
   return -1 == order(x,y);
 }
 
+/*
+  Batched order queries.
+
+  A query loads x, y and both of their bases, and the base loads depend
+  on the node loads (or, in the compact layout, on the chunk headers).
+  Rather than taking those misses one query at a time, the batch is
+  cut into groups of GROUP pairs that move through a three-stage
+  pipeline: while the tags of group g are read, the bases of group g+1
+  and the nodes of group g+2 are being prefetched, so a whole group's
+  misses are in flight together. This is the static schedule that AMAC
+  reduces to when every lookup has the same fixed chain of dependent
+  loads.
+
+  The gathered relative tags of each group are then compared by a
+  kernel picked once at runtime: AVX2 or SSE when the CPU has them,
+  otherwise a plain loop. Build with ORDMAIN_BATCH_KERNEL defined to
+  avx2, sse or scalar to use that kernel instead, so that each one can
+  be tested on a CPU that would pick another. The CPU must still have
+  its instructions.
+*/
+
+#define GROUP 16
+
+#if defined(__GNUC__)
+#define PREFETCH(p) __builtin_prefetch((p), 0, 3)
+#else
+#define PREFETCH(p) ((void)(p))
+#endif
 
 static void
-destroy(struct ordmain_node * const x) {
-  /* Unset base members to assist in catching memory errors. */
-#ifndef NDEBUG
-  x->base = NULL;
-  x->prev = NULL;
-  x->next = NULL;
-#endif /* NDEBUG */
-  free(x);
-  return;
+prefetch_nodes(const struct ordmain_node * const * const xs,
+               const struct ordmain_node * const * const ys,
+               const size_t lo, const size_t hi) {
+  for (size_t i = lo; i < hi; ++i) {
+    PREFETCH(xs[i]);
+    PREFETCH(ys[i]);
+  }
+}
+
+static void
+prefetch_bases(const struct ordmain_node * const * const xs,
+               const struct ordmain_node * const * const ys,
+               const size_t lo, const size_t hi) {
+  for (size_t i = lo; i < hi; ++i) {
+    if ((NULL != xs[i]) && (NULL != ys[i])) {
+#ifdef ORDMAIN_COMPACT
+      PREFETCH(chunk_of(xs[i]));
+      PREFETCH(chunk_of(ys[i]));
+#else
+      PREFETCH(xs[i]->base);
+      PREFETCH(ys[i]->base);
+#endif
+    }
+  }
+}
+
+/*
+  Fills xt, yt and same for pairs lo through hi-1. same[k] is 1 when
+  the pair is valid, and 0 when either node is NULL or they are in
+  different lists, in which case errno is set to EINVAL as order()
+  would.
+*/
+static void
+gather(const struct ordmain_node * const * const xs,
+       const struct ordmain_node * const * const ys,
+       const size_t lo, const size_t hi,
+       tag_t * const xt, tag_t * const yt, uint8_t * const same) {
+  for (size_t i = lo; i < hi; ++i) {
+    const struct ordmain_node * const x = xs[i];
+    const struct ordmain_node * const y = ys[i];
+    if ((NULL == x) || (NULL == y) || (base_of(x) != base_of(y))) {
+      errno = EINVAL;
+      xt[i-lo] = 0;
+      yt[i-lo] = 0;
+      same[i-lo] = 0;
+      continue;
+    }
+    const struct ordmain_list * const l = list_of(x);
+    const struct ordmain_node * const base = base_of(x);
+    unsigned seq;
+    do {
+      seq = read_begin(l);
+      const tag_t base_tag = load_tag(base);
+      xt[i-lo] = load_tag(x) - base_tag;
+      yt[i-lo] = load_tag(y) - base_tag;
+    } while (read_retry(l, seq));
+    same[i-lo] = 1;
+  }
+}
+
+/*
+  A compare kernel sets out[k] to 1 exactly when same[k] is 1 and
+  xt[k] < yt[k], for k < n.
+*/
+typedef void compare_kernel(const tag_t *, const tag_t *, const uint8_t *,
+                            size_t, uint8_t *);
+
+static void
+compare_scalar(const tag_t * const xt, const tag_t * const yt,
+               const uint8_t * const same, const size_t n,
+               uint8_t * const out) {
+  for (size_t k = 0; k < n; ++k) {
+    out[k] = same[k] & (xt[k] < yt[k]);
+  }
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+
+/* nibble_bytes[m] has byte k set to bit k of m, for a 4-bit mask m,
+   on a little-endian machine. */
+#define NIBBLE_BYTES(m) ((((m) & 1u)) | (((m) & 2u) << 7)               \
+                         | (((m) & 4u) << 14) | (((m) & 8u) << 21))
+static const uint32_t nibble_bytes[16] = {
+  NIBBLE_BYTES(0),  NIBBLE_BYTES(1),  NIBBLE_BYTES(2),  NIBBLE_BYTES(3),
+  NIBBLE_BYTES(4),  NIBBLE_BYTES(5),  NIBBLE_BYTES(6),  NIBBLE_BYTES(7),
+  NIBBLE_BYTES(8),  NIBBLE_BYTES(9),  NIBBLE_BYTES(10), NIBBLE_BYTES(11),
+  NIBBLE_BYTES(12), NIBBLE_BYTES(13), NIBBLE_BYTES(14), NIBBLE_BYTES(15)
+};
+
+/* Stores four result bytes: the low four bits of ${mask}, each ANDed
+   with the matching byte of ${same}. */
+static void
+store_nibble(const unsigned mask, const uint8_t * const same,
+             uint8_t * const out) {
+  uint32_t word;
+  memcpy(&word, same, sizeof(word));
+  word &= nibble_bytes[mask & 15u];
+  memcpy(out, &word, sizeof(word));
+}
+
+/* There are no unsigned integer compares before AVX-512, so the tags
+   are biased by the sign bit and compared as signed. */
+
+#ifdef ORDMAIN_WIDE_TAGS
+
+__attribute__((target("sse4.2")))
+static void
+compare_sse(const tag_t * const xt, const tag_t * const yt,
+            const uint8_t * const same, const size_t n,
+            uint8_t * const out) {
+  const __m128i bias = _mm_set1_epi64x((long long)(1ull << 63));
+  size_t k = 0;
+  for (; k + 4 <= n; k += 4) {
+    const __m128i x0 = _mm_xor_si128(bias, _mm_loadu_si128((const __m128i *)(xt + k)));
+    const __m128i y0 = _mm_xor_si128(bias, _mm_loadu_si128((const __m128i *)(yt + k)));
+    const __m128i x1 = _mm_xor_si128(bias, _mm_loadu_si128((const __m128i *)(xt + k + 2)));
+    const __m128i y1 = _mm_xor_si128(bias, _mm_loadu_si128((const __m128i *)(yt + k + 2)));
+    const unsigned lo = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(y0, x0)));
+    const unsigned hi = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(y1, x1)));
+    store_nibble(lo | (hi << 2), same + k, out + k);
+  }
+  compare_scalar(xt + k, yt + k, same + k, n - k, out + k);
+}
+
+__attribute__((target("avx2")))
+static void
+compare_avx2(const tag_t * const xt, const tag_t * const yt,
+             const uint8_t * const same, const size_t n,
+             uint8_t * const out) {
+  const __m256i bias = _mm256_set1_epi64x((long long)(1ull << 63));
+  size_t k = 0;
+  for (; k + 4 <= n; k += 4) {
+    const __m256i x = _mm256_xor_si256(bias, _mm256_loadu_si256((const __m256i *)(xt + k)));
+    const __m256i y = _mm256_xor_si256(bias, _mm256_loadu_si256((const __m256i *)(yt + k)));
+    const unsigned mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(y, x)));
+    store_nibble(mask, same + k, out + k);
+  }
+  compare_scalar(xt + k, yt + k, same + k, n - k, out + k);
+}
+
+#else /* ORDMAIN_WIDE_TAGS */
+
+__attribute__((target("sse2")))
+static void
+compare_sse(const tag_t * const xt, const tag_t * const yt,
+            const uint8_t * const same, const size_t n,
+            uint8_t * const out) {
+  const __m128i bias = _mm_set1_epi32((int)(1u << 31));
+  size_t k = 0;
+  for (; k + 4 <= n; k += 4) {
+    const __m128i x = _mm_xor_si128(bias, _mm_loadu_si128((const __m128i *)(xt + k)));
+    const __m128i y = _mm_xor_si128(bias, _mm_loadu_si128((const __m128i *)(yt + k)));
+    const unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(y, x)));
+    store_nibble(mask, same + k, out + k);
+  }
+  compare_scalar(xt + k, yt + k, same + k, n - k, out + k);
+}
+
+__attribute__((target("avx2")))
+static void
+compare_avx2(const tag_t * const xt, const tag_t * const yt,
+             const uint8_t * const same, const size_t n,
+             uint8_t * const out) {
+  const __m256i bias = _mm256_set1_epi32((int)(1u << 31));
+  size_t k = 0;
+  for (; k + 8 <= n; k += 8) {
+    const __m256i x = _mm256_xor_si256(bias, _mm256_loadu_si256((const __m256i *)(xt + k)));
+    const __m256i y = _mm256_xor_si256(bias, _mm256_loadu_si256((const __m256i *)(yt + k)));
+    const unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(y, x)));
+    store_nibble(mask, same + k, out + k);
+    store_nibble(mask >> 4, same + k + 4, out + k + 4);
+  }
+  compare_scalar(xt + k, yt + k, same + k, n - k, out + k);
+}
+
+#endif /* ORDMAIN_WIDE_TAGS */
+#endif /* __GNUC__ && x86 */
+
+#define KERNEL_NAMED(k) compare_ ## k
+#define KERNEL(k) KERNEL_NAMED(k)
+
+static compare_kernel *
+pick_kernel(void) {
+#ifdef ORDMAIN_BATCH_KERNEL
+  return KERNEL(ORDMAIN_BATCH_KERNEL);
+#endif
+#ifdef HAVE_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return compare_avx2;
+  }
+#ifdef ORDMAIN_WIDE_TAGS
+  if (__builtin_cpu_supports("sse4.2")) {
+    return compare_sse;
+  }
+#else
+  if (__builtin_cpu_supports("sse2")) {
+    return compare_sse;
+  }
+#endif
+#endif
+  return compare_scalar;
+}
+
+#ifdef ORDMAIN_STATS
+/*
+  Counts the queries of a batch against the list of each ${xs[i]}, as
+  ordmain_in_order would, taking each run of pairs whose xs share a
+  list at once.
+*/
+static void
+count_batch(const struct ordmain_node * const * const xs, const size_t n) {
+  size_t i = 0;
+  while (i < n) {
+    if (NULL == xs[i]) {
+      ++i;
+      continue;
+    }
+    struct ordmain_list * const l = list_of(xs[i]);
+    size_t j = i + 1;
+    while ((j < n) && (NULL != xs[j]) && (list_of(xs[j]) == l)) {
+      ++j;
+    }
+    count_queries(l, j - i);
+    i = j;
+  }
+}
+#endif
+
+void
+ordmain_in_order_batch(const struct ordmain_node * const * const xs,
+                       const struct ordmain_node * const * const ys,
+                       const size_t n, uint8_t * const out) {
+  /* Threads may race to fill this in, but they all store the same
+     value, and the atomics keep that race defined. */
+  static compare_kernel * cached = NULL;
+  STAT(count_batch(xs, n));
+#if defined(__GNUC__)
+  compare_kernel * compare = __atomic_load_n(&cached, __ATOMIC_RELAXED);
+  if (NULL == compare) {
+    compare = pick_kernel();
+    __atomic_store_n(&cached, compare, __ATOMIC_RELAXED);
+  }
+#else
+  if (NULL == cached) {
+    cached = pick_kernel();
+  }
+  compare_kernel * const compare = cached;
+#endif
+  tag_t xt[GROUP];
+  tag_t yt[GROUP];
+  uint8_t same[GROUP];
+
+  const size_t ahead = (n < 2*GROUP) ? n : 2*GROUP;
+  prefetch_nodes(xs, ys, 0, ahead);
+  prefetch_bases(xs, ys, 0, (n < GROUP) ? n : GROUP);
+  for (size_t lo = 0; lo < n; lo += GROUP) {
+    const size_t hi = (n - lo < GROUP) ? n : lo + GROUP;
+    if (hi + GROUP < n) {
+      prefetch_nodes(xs, ys, hi + GROUP,
+                     (n - (hi + GROUP) < GROUP) ? n : hi + 2*GROUP);
+    }
+    if (hi < n) {
+      prefetch_bases(xs, ys, hi, (n - hi < GROUP) ? n : hi + GROUP);
+    }
+    gather(xs, ys, lo, hi, xt, yt, same);
+    compare(xt, yt, same, hi - lo, out + lo);
+  }
+}
+
+
+/*
+  Sorting nodes by list order.
+
+  Each node's relative tag is read once, into an array of (key, node)
+  pairs, which is then LSD radix sorted a byte at a time. All the
+  digit histograms are built in one pass before any scattering, and a
+  pass is skipped when every key has the same digit there.
+*/
+
+struct keyed {
+  tag_t key;
+  struct ordmain_node * node;
+};
+
+#define RADIX_BITS 8
+#define RADIX (1 << RADIX_BITS)
+#define DIGITS ((int)(sizeof(tag_t) * 8 / RADIX_BITS))
+/* Below this size, insertion sort beats the fixed cost of the
+   histograms. */
+#define SMALL_SORT 64
+
+static void
+insertion_sort(struct keyed * const a, const size_t n) {
+  for (size_t i = 1; i < n; ++i) {
+    const struct keyed v = a[i];
+    size_t k = i;
+    while ((k > 0) && (a[k-1].key > v.key)) {
+      a[k] = a[k-1];
+      --k;
+    }
+    a[k] = v;
+  }
+}
+
+int
+ordmain_sort(struct ordmain_node ** const nodes, const size_t n) {
+  if (n < 2) {
+    return 0;
+  }
+  if ((NULL == nodes) || (NULL == nodes[0])) {
+    errno = EINVAL;
+    return -1;
+  }
+  const struct ordmain_node * const base = base_of(nodes[0]);
+  struct keyed * const buffer = malloc(2 * n * sizeof(struct keyed));
+  if (NULL == buffer) {
+    errno = ENOMEM;
+    return -1;
+  }
+  struct keyed * a = buffer;
+  struct keyed * b = buffer + n;
+
+  for (size_t i = 0; i < n; ++i) {
+    if (i + GROUP < n) {
+      PREFETCH(nodes[i + GROUP]);
+    }
+    if ((NULL == nodes[i]) || (base_of(nodes[i]) != base)) {
+      free(buffer);
+      errno = EINVAL;
+      return -1;
+    }
+    a[i].key = nodes[i]->tag - base->tag;
+    a[i].node = nodes[i];
+  }
+
+  if (n <= SMALL_SORT) {
+    insertion_sort(a, n);
+  } else {
+    size_t count[DIGITS][RADIX] = {{0}};
+    for (size_t i = 0; i < n; ++i) {
+      const tag_t key = a[i].key;
+      for (int d = 0; d < DIGITS; ++d) {
+        ++count[d][(key >> (d * RADIX_BITS)) & (RADIX - 1)];
+      }
+    }
+    for (int d = 0; d < DIGITS; ++d) {
+      const tag_t first = (a[0].key >> (d * RADIX_BITS)) & (RADIX - 1);
+      if (n == count[d][first]) {
+        continue;
+      }
+      size_t offset = 0;
+      for (int r = 0; r < RADIX; ++r) {
+        const size_t here = count[d][r];
+        count[d][r] = offset;
+        offset += here;
+      }
+      for (size_t i = 0; i < n; ++i) {
+        const size_t r = (a[i].key >> (d * RADIX_BITS)) & (RADIX - 1);
+        b[count[d][r]++] = a[i];
+      }
+      struct keyed * const t = a;
+      a = b;
+      b = t;
+    }
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    nodes[i] = a[i].node;
+  }
+  free(buffer);
+  return 0;
 }
 
 void ordmain_delete(struct ordmain_node * const x) {
   if (NULL == x) {
     return;
   }
-  assert (NULL != x->prev);
-  assert (NULL != x->next);
+  struct ordmain_list * const l = list_of(x);
   /* can't delete base, user should never be able to get a pointer to
      base anyway: */
-  assert (x->base != x); 
-  x->prev->next = x->next;
-  x->next->prev = x->prev;
+  assert (base_of(x) != x); 
+  rank_delete(l, x);
+  link(l, prev_in(l, x), next_in(l, x));
+  STAT(++l->stats.deletes);
   /* If the only node left is the base, free it. The user can't have a
      pointer to it, so unless we free it now, it will be leaked.*/
-  if (x->base->next == x->base) {
-    destroy(x->base);
+  if (next_in(l, base_in(l)) == base_in(l)) {
+    destroy_list(l);
+    return;
   }
   destroy(x);
 }
+
+void ordmain_destroy_list(struct ordmain_node * const x) {
+  if (NULL == x) {
+    return;
+  }
+  assert (NULL != base_of(x));
+  destroy_list(list_of(x));
+}
+
+int ordmain_get_stats(const struct ordmain_node * const x,
+                      struct ordmain_stats * const out) {
+#ifdef ORDMAIN_STATS
+  if ((NULL == x) || (NULL == out)) {
+    errno = EINVAL;
+    return -1;
+  }
+  *out = list_of(x)->stats;
+  return 0;
+#else
+  (void)x;
+  (void)out;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+int ordmain_rank(const struct ordmain_node * const x, size_t * const out) {
+#ifdef ORDMAIN_RANK
+  if ((NULL == x) || (NULL == out)) {
+    errno = EINVAL;
+    return -1;
+  }
+  assert (base_of(x) != x);
+  *out = rank(x);
+  return 0;
+#else
+  (void)x;
+  (void)out;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+int ordmain_distance(const struct ordmain_node * const x,
+                     const struct ordmain_node * const y,
+                     ptrdiff_t * const out) {
+#ifdef ORDMAIN_RANK
+  if ((NULL == x) || (NULL == y) || (NULL == out)
+      || (base_of(x) != base_of(y))) {
+    errno = EINVAL;
+    return -1;
+  }
+  *out = (ptrdiff_t)rank(y) - (ptrdiff_t)rank(x);
+  return 0;
+#else
+  (void)x;
+  (void)y;
+  (void)out;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
@@ -0,0 +1,931 @@
+/*
+
+Two-level order maintenance, after Dietz and Sleator, "Two Algorithms
+for Maintaining Order in a List", and Bender et al., "Two Simplified
+Algorithms for Maintaining Order in a List".
+
+The nodes of a list, called leaves here, are cut into consecutive
+runs called sublists. A list keeps its sublists in order with the
+same relabeling scheme as baseamort.c, and each sublist keeps its
+leaves in order with tags of its own, so two leaves compare by their
+own tags when they share a sublist and by their sublists' tags
+otherwise.
+
+A sublist holds at most ${limit} leaves, and ${limit} grows by one
+each time the number of sublists doubles, up to BLOCK, so sublists
+hold O(log n) leaves for any n that fits in memory. A leaf insert
+relabels at most its own sublist. When a sublist is full, it is split
+in two before the insert, which relabels O(log n) leaves and inserts
+one sublist at the top, at an amortized cost of O(log n) top-level
+relabels. Splits happen once every O(log n) inserts, so inserts take
+O(1) amortized time. A sublist that shrinks to a quarter of the limit
+is merged into a neighbor, or evened out with it, so deletes are O(1)
+amortized too.
+
+A sublist is one block with room for BLOCK leaves. Each leaf is a
+slot in it: a one-byte tag in ${tags}, and a pointer in ${doors} back
+to the leaf's finger. Blocks are allocated aligned to LINE, so the
+tags fill the block's first cache line. The slots are kept in no
+particular order: a new leaf takes the first free slot, and a delete
+fills the hole it leaves with the last slot, so inserts never move
+other leaves. Only the tags say which leaf comes first. Since a
+leaf lives in its sublist's block, churn cannot scatter the leaves of
+a sublist over the heap, and every split and merge writes the slots
+it touches back in list order, so there is nothing for a compaction
+pass to restore.
+
+The user holds a finger, which points to its sublist through ${home}
+and to its slot there through ${slot}. Leaves can then be moved
+without invalidating what the user holds.
+
+The deamortized build orders the sublists differently, with a tree of
+blocks rather than tags of their own; see "Worst-case build" below.
+
+ */
+
+/* for posix_memalign */
+#define _POSIX_C_SOURCE 200112L
+
+#include "dsamort.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <errno.h>
+
+typedef uint64_t tag_t;
+typedef uint32_t count_t;
+typedef uint8_t log_t;
+typedef uint8_t local_t;
+
+#define TAG_MAX ((tag_t)~((tag_t)0))
+#define COUNT_MAX ((count_t)~((count_t)0))
+#define LOCAL_MAX ((local_t)~((local_t)0))
+
+/* The most leaves a sublist can hold */
+#define BLOCK 64
+
+/* The size of a cache line, which sublists are aligned to */
+#define LINE 64
+
+/* A new list lets sublists hold MIN_LIMIT leaves, and raises that by
+   one when it reaches FIRST_ONEUP sublists, and at every doubling
+   after that. */
+#define MIN_LIMIT 32
+#define FIRST_ONEUP 16
+
+struct list;
+struct sublist;
+
+/* The finger */
+struct ordmain_ds_node {
+  struct sublist * home;
+  log_t slot;
+};
+
+struct sublist {
+  /* The tags of the leaves in slots 0 to ${size} - 1, strictly between
+     0 and LOCAL_MAX */
+  local_t tags[BLOCK];
+  log_t size;
+#ifdef ORDMAIN_DS_DEAMORTIZED
+  /* 0 for a sublist, and one more per level for the blocks above. See
+     "Worst-case build" below. */
+  log_t height;
+#endif
+  tag_t tag;
+  struct list * parent;
+  /* The sublists of a list are linked in a circle through its base,
+     and the blocks of each level above them in a line. */
+  struct sublist * prev;
+  struct sublist * next;
+#ifdef ORDMAIN_DS_DEAMORTIZED
+  /* The slot of this block in the block above it. ${up.home} is NULL
+     at the root. */
+  struct ordmain_ds_node up;
+#endif
+  struct ordmain_ds_node * doors[BLOCK];
+};
+
+struct list {
+  /* The base holds no leaves. Sublist tags are compared relative to
+     its tag, since relabels may wrap around past it. */
+  struct sublist base;
+  /* The number of sublists, not counting the base */
+  count_t size;
+  size_t leaves;
+  log_t limit; // The limit of sublist length
+  count_t oneup; // The size at which we increase the limit
+#ifdef ORDMAIN_DS_DEAMORTIZED
+  /* The block at the top of the tree */
+  struct sublist * root;
+#endif
+#ifdef ORDMAIN_STATS
+  struct ordmain_ds_stats stats;
+#endif
+};
+
+/*
+  STAT(statement) runs statement only in builds with ORDMAIN_STATS
+  defined, so that the counters cost nothing otherwise.
+*/
+#ifdef ORDMAIN_STATS
+#define STAT(statement) statement
+#else
+#define STAT(statement)
+#endif
+
+#ifdef ORDMAIN_STATS
+/* Counts ${many} slots of ${s} given new tags. */
+static void
+count_relabeled(const struct sublist * const s, const unsigned many) {
+#ifdef ORDMAIN_DS_DEAMORTIZED
+  if (0 < s->height) {
+    s->parent->stats.top_relabeled += many;
+    return;
+  }
+#endif
+  s->parent->stats.relabeled += many;
+}
+
+/*
+  Called at the end of an insert or delete, with the counters of
+  relabels as they were at its start, to update the most of them any
+  one operation did.
+*/
+static void
+count_op(struct list * const l, const uint64_t relabeled,
+         const uint64_t top_relabeled) {
+  const uint64_t top = l->stats.top_relabeled - top_relabeled;
+  const uint64_t steps = l->stats.relabeled - relabeled + top;
+  if (top > l->stats.max_top_relabel) {
+    l->stats.max_top_relabel = top;
+  }
+  if (steps > l->stats.max_steps) {
+    l->stats.max_steps = steps;
+  }
+}
+#endif
+
+/*
+  Returns a new, uninitialized sublist aligned to LINE, so that its
+  ${tags} share one cache line, or NULL with errno set to ENOMEM.
+*/
+static struct sublist *
+new_sublist(void) {
+  void * raw;
+  if (0 != posix_memalign(&raw, LINE, sizeof(struct sublist))) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  return raw;
+}
+
+#ifndef ORDMAIN_DS_DEAMORTIZED
+
+/*
+  The top level: sublists ordered by baseamort's relabeling.
+*/
+
+/*
+  Returns floor(w * k / j), for 0 < k < j, the offset at which the
+  k-th of j-1 evenly spaced sublists goes in a gap of width w. As in
+  baseamort.c with wide tags, w * k does not fit in a tag_t, so it is
+  computed as q * k + r * k / j, where w = q * j + r. That cannot
+  overflow, because count_t is half as wide as tag_t.
+*/
+static tag_t
+spread(const tag_t w, const count_t k, const count_t j) {
+  assert (0 < k);
+  assert (k < j);
+  const tag_t q = w / j;
+  const tag_t r = w % j;
+  return q * k + (r * k) / j;
+}
+
+/*
+  Links the sublist ${h} in just after ${x} and gives it a tag. As in
+  ordmain_insert_after, this walks from x to the first xj whose tag is
+  more than j^2 past x's, then spreads the j-1 sublists in between
+  evenly. Returns false, with errno set to ENOSPC, if the list has as
+  many sublists as a count_t can hold.
+*/
+static bool
+top_insert(struct list * const l, struct sublist * const x,
+           struct sublist * const h) {
+  /* j counts up to one more than the number of sublists after x */
+  if (l->size >= COUNT_MAX - 1) {
+    errno = ENOSPC;
+    return false;
+  }
+  assert (x->next != x);
+  count_t j = 1;
+  struct sublist * xj = x->next;
+  tag_t wj = xj->tag - x->tag;
+  assert (0 != wj);
+  tag_t j2 = 1;
+  while (wj <= j2) {
+    ++j;
+    assert (0 != j);
+    xj = xj->next;
+    wj = xj->tag - x->tag;
+    if (0 == wj) { // gone around
+      wj = TAG_MAX;
+      break;
+    }
+    j2 = ((tag_t)j) * ((tag_t)j);
+  }
+  struct sublist * xk = x->next;
+  for (count_t k = 1; k < j; ++k) {
+    xk->tag = x->tag + spread(wj, k, j);
+    xk = xk->next;
+  }
+  STAT(l->stats.top_relabeled += j - 1);
+
+  struct sublist * const after = x->next;
+  h->tag = x->tag + (after->tag - x->tag)/2;
+  assert (h->tag != x->tag);
+  assert (h->tag != after->tag);
+  h->prev = x;
+  h->next = after;
+  x->next = h;
+  after->prev = h;
+  h->parent = l;
+  ++l->size;
+  return true;
+}
+
+static void
+top_delete(struct sublist * const s) {
+  s->prev->next = s->next;
+  s->next->prev = s->prev;
+  --s->parent->size;
+  free(s);
+}
+
+#endif /* ORDMAIN_DS_DEAMORTIZED */
+
+/*
+  The bottom level: leaves within a sublist. Their tags are strictly
+  between 0 and LOCAL_MAX, so the first and last leaves always have
+  room on their outer sides. A byte is enough for BLOCK leaves, but
+  not by much, so relabeling a sublist is frequent, and done in a few
+  word operations rather than by walking the leaves in order. In the
+  deamortized build, the blocks above the sublists go through the same
+  functions, with the fingers of the blocks below in their slots.
+*/
+
+/* The tags just before and just after a place in a sublist */
+struct gap {
+  unsigned lo;
+  unsigned hi;
+};
+
+/*
+  Returns the greatest tag in ${s} below ${t}, or 0 if there is none.
+*/
+static unsigned
+below(const struct sublist * const s, const unsigned t) {
+  unsigned ans = 0;
+  for (log_t i = 0; i < s->size; ++i) {
+    const unsigned u = s->tags[i];
+    ans = ((u < t) && (u > ans)) ? u : ans;
+  }
+  return ans;
+}
+
+/*
+  Returns the least tag in ${s} above ${t}, or LOCAL_MAX if there is
+  none.
+*/
+static unsigned
+above(const struct sublist * const s, const unsigned t) {
+  unsigned ans = LOCAL_MAX;
+  for (log_t i = 0; i < s->size; ++i) {
+    const unsigned u = s->tags[i];
+    ans = ((u > t) && (u < ans)) ? u : ans;
+  }
+  return ans;
+}
+
+#if defined(__GNUC__)
+#define POPCOUNT(x) __builtin_popcountll(x)
+#else
+static unsigned
+popcount(uint64_t x) {
+  x = x - ((x >> 1) & 0x5555555555555555ull);
+  x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+  return (unsigned)((x * 0x0101010101010101ull) >> 56);
+}
+#define POPCOUNT(x) popcount(x)
+#endif
+
+/*
+  Sets ${rank}[i] to the number of leaves of ${s} before the one in
+  slot i. Tags are distinct bytes, so they are set as bits of a
+  256-bit map, and a leaf's rank is the number of bits below its own.
+*/
+static void
+rank_slots(const struct sublist * const s, log_t * const rank) {
+  uint64_t bits[(LOCAL_MAX + 1) / 64] = {0};
+  for (log_t i = 0; i < s->size; ++i) {
+    bits[s->tags[i] / 64] |= (uint64_t)1 << (s->tags[i] % 64);
+  }
+  unsigned before[(LOCAL_MAX + 1) / 64];
+  before[0] = 0;
+  for (unsigned w = 1; w < (LOCAL_MAX + 1) / 64; ++w) {
+    before[w] = before[w - 1] + POPCOUNT(bits[w - 1]);
+  }
+  for (log_t i = 0; i < s->size; ++i) {
+    const unsigned t = s->tags[i];
+    const uint64_t lower = ((uint64_t)1 << (t % 64)) - 1;
+    rank[i] = (log_t)(before[t / 64] + POPCOUNT(bits[t / 64] & lower));
+  }
+}
+
+/*
+  Spreads the tags of the leaves of ${s} without moving any of them to
+  another slot, and returns the gap left for a new leaf that goes just
+  after the leaf tagged ${lo}, or first if lo is 0. Half of the tags go
+  to that gap and the other half are spread evenly, since the next
+  inserts are likely to land in the same place: with only a byte of
+  tags, an even spread would leave room for two or three of them.
+*/
+static struct gap
+relabel(struct sublist * const s, const unsigned lo) {
+  log_t rank[BLOCK];
+  rank_slots(s, rank);
+  unsigned hole = 0;
+  for (log_t i = 0; i < s->size; ++i) {
+    hole += (s->tags[i] <= lo);
+  }
+  const unsigned half = (LOCAL_MAX + 1) / 2;
+  const unsigned step = (LOCAL_MAX - half) / ((unsigned)s->size + 1);
+  assert (1 <= step);
+  for (log_t i = 0; i < s->size; ++i) {
+    const unsigned r = rank[i];
+    s->tags[i] = (local_t)((r + 1) * step + ((r < hole) ? 0 : half));
+  }
+  const struct gap ans = {hole * step, (hole + 1) * step + half};
+  return ans;
+}
+
+/*
+  Appends the fingers of the leaves of ${s} to ${out}, in list order.
+  Returns how many there were.
+*/
+static unsigned
+gather(const struct sublist * const s, struct ordmain_ds_node ** const out) {
+  log_t rank[BLOCK];
+  rank_slots(s, rank);
+  for (log_t i = 0; i < s->size; ++i) {
+    out[rank[i]] = s->doors[i];
+  }
+  return s->size;
+}
+
+/*
+  Makes the ${n} leaves whose fingers are in ${in} the leaves of ${s},
+  in that order, with evenly spread tags.
+*/
+static void
+place(struct sublist * const s, struct ordmain_ds_node * const * const in,
+      const unsigned n) {
+  assert (n <= BLOCK);
+  const unsigned step = LOCAL_MAX / (n + 1);
+  for (unsigned i = 0; i < n; ++i) {
+    s->tags[i] = (local_t)((i + 1) * step);
+    s->doors[i] = in[i];
+    in[i]->home = s;
+    in[i]->slot = (log_t)i;
+  }
+  s->size = (log_t)n;
+}
+
+/*
+  Moves the leaves of the adjacent sublists ${left} and ${right} so
+  that the first ${keep} of them are in ${left} and the rest in
+  ${right}, and relabels both as relabel would, in the same pass.
+*/
+static void
+divide(struct sublist * const left, struct sublist * const right,
+       const log_t keep) {
+  assert (left->next == right);
+  struct ordmain_ds_node * all[2 * BLOCK];
+  unsigned total = gather(left, all);
+  total += gather(right, all + total);
+  assert (0 < keep);
+  assert (keep < total);
+  place(left, all, keep);
+  place(right, all + keep, total - keep);
+  STAT(count_relabeled(left, total));
+}
+
+/* Empties the slot of ${x}, filling the hole with the last slot. */
+static void
+unslot(const struct ordmain_ds_node * const x) {
+  struct sublist * const s = x->home;
+  const log_t i = x->slot;
+  assert (s->doors[i] == x);
+  const log_t last = s->size - 1;
+  s->tags[i] = s->tags[last];
+  s->doors[i] = s->doors[last];
+  s->doors[i]->slot = i;
+  --s->size;
+}
+
+/*
+  Returns the block just after ${s} at its level, or the one just
+  before if s is the last, or NULL if s is alone there. The base is
+  not a neighbor.
+*/
+static struct sublist *
+neighbor(const struct sublist * const s) {
+  const struct sublist * const base = &s->parent->base;
+  struct sublist * n = s->next;
+  if ((NULL == n) || (base == n)) {
+    n = s->prev;
+  }
+  return ((NULL == n) || (base == n)) ? NULL : n;
+}
+
+#ifndef ORDMAIN_DS_DEAMORTIZED
+/*
+  Splits ${s} in half, moving its second half into a new sublist just
+  after it. Returns false on error, with errno set and nothing changed.
+*/
+static bool
+split_sublist(struct sublist * const s) {
+  struct list * const l = s->parent;
+  assert (2 <= s->size);
+  struct sublist * const t = new_sublist();
+  if (NULL == t) {
+    return false;
+  }
+  if (!top_insert(l, s, t)) {
+    free(t);
+    return false;
+  }
+  t->size = 0;
+  divide(s, t, s->size / 2);
+  STAT(++l->stats.splits);
+  if ((l->size >= l->oneup) && (l->oneup <= COUNT_MAX / 2)
+      && (l->limit < BLOCK)) {
+    ++l->limit;
+    l->oneup *= 2;
+  }
+  return true;
+}
+
+static bool
+make_room(struct sublist * const s) {
+  return (s->size < s->parent->limit) || split_sublist(s);
+}
+
+#else /* ORDMAIN_DS_DEAMORTIZED */
+
+/*
+  Worst-case build.
+
+  In the deamortized build, sublists have no tags of their own.
+  Instead they are the leaves of a tree of blocks, each a struct
+  sublist whose slots hold the fingers ${up} of the blocks just below
+  it, with one-byte tags as in a sublist. All sublists are ${height}
+  levels below the root, so two sublists compare by walking up from
+  both, one level at a time, to the block where their paths meet. The
+  blocks of each level are linked in order through ${prev} and
+  ${next}: the sublists in a circle through the base, as in the other
+  build, and the blocks above them in a line that ends in NULL both
+  ways.
+
+  Every block but the root holds between CAP / 4 and CAP slots. A full
+  block is split in two before a slot goes in, which puts a slot for
+  the new block in the block above it, and may split that one in turn.
+  A block left with fewer than CAP / 4 slots is merged into, or evened
+  out with, its neighbor, as merge_sublist does with sublists, and a
+  merge takes a slot out of the block above it, which may merge that
+  one in turn. The root gets a new block above it when it splits, and
+  is replaced by its only child when it has one slot left. So an
+  insert or delete relabels, splits or merges at most one block per
+  level, each in O(CAP) steps, with no work left over for later. A
+  list of n sublists has at most 1 + log(n / 2) / log(CAP / 4) levels
+  of blocks above them, 8 for the most sublists a count_t allows, so
+  that bounds the work of every operation by a constant. Queries pay
+  for it: two leaves of different sublists compare in one step per
+  level, rather than by their sublists' tags.
+*/
+
+#define CAP BLOCK
+
+static bool slot_in(struct ordmain_ds_node * x, struct ordmain_ds_node * h,
+                    bool after);
+
+/* Returns the block whose finger is ${f}. */
+static struct sublist *
+owner(struct ordmain_ds_node * const f) {
+  return (struct sublist *)((char *)f - offsetof(struct sublist, up));
+}
+
+/*
+  Splits the full block ${s} in half, moving its second half into a
+  new block just after it, and puts a slot for that one in the block
+  above, splitting it in turn if need be. Returns false on error, with
+  errno set and the order of the list unchanged, though blocks above s
+  may have been split already.
+*/
+static bool
+split_block(struct sublist * const s) {
+  struct list * const l = s->parent;
+  assert (CAP == s->size);
+  if ((0 == s->height) && (l->size >= COUNT_MAX - 1)) {
+    errno = ENOSPC;
+    return false;
+  }
+  struct sublist * const t = new_sublist();
+  if (NULL == t) {
+    return false;
+  }
+  t->size = 0;
+  t->height = s->height;
+  t->tag = 0;
+  t->parent = l;
+  if (NULL == s->up.home) {
+    struct sublist * const r = new_sublist();
+    if (NULL == r) {
+      free(t);
+      return false;
+    }
+    r->size = 1;
+    r->height = s->height + 1;
+    r->tag = 0;
+    r->parent = l;
+    r->prev = NULL;
+    r->next = NULL;
+    r->up.home = NULL;
+    r->up.slot = 0;
+    r->tags[0] = LOCAL_MAX >> 1;
+    r->doors[0] = &s->up;
+    s->up.home = r;
+    s->up.slot = 0;
+    l->root = r;
+  }
+  if (!slot_in(&s->up, &t->up, true)) {
+    free(t);
+    return false;
+  }
+  t->prev = s;
+  t->next = s->next;
+  if (NULL != t->next) {
+    t->next->prev = t;
+  }
+  s->next = t;
+  if (0 == s->height) {
+    ++l->size;
+  }
+  divide(s, t, CAP / 2);
+  STAT(++l->stats.splits);
+  return true;
+}
+
+static bool
+make_room(struct sublist * const s) {
+  return (s->size < CAP) || split_block(s);
+}
+
+static void merge_sublist(struct sublist * s);
+
+/*
+  Takes the block ${s} out of its level and out of the block above it,
+  then frees it. That block then merges if it got too small, or, if it
+  is the root and has one slot left, gives way to the block in it.
+*/
+static void
+top_delete(struct sublist * const s) {
+  struct list * const l = s->parent;
+  struct sublist * const p = s->up.home;
+  assert (NULL != p);
+  unslot(&s->up);
+  if (NULL != s->prev) {
+    s->prev->next = s->next;
+  }
+  if (NULL != s->next) {
+    s->next->prev = s->prev;
+  }
+  if (0 == s->height) {
+    --l->size;
+  }
+  free(s);
+  if (p != l->root) {
+    if (4 * (unsigned)p->size < CAP) {
+      merge_sublist(p);
+    }
+    return;
+  }
+  while ((0 < l->root->height) && (1 == l->root->size)) {
+    struct sublist * const r = l->root;
+    l->root = owner(r->doors[0]);
+    l->root->up.home = NULL;
+    free(r);
+  }
+}
+
+/* Frees ${s} and every block below it that is not a sublist. */
+static void
+free_blocks(struct sublist * const s) {
+  if (0 == s->height) {
+    return;
+  }
+  for (log_t i = 0; i < s->size; ++i) {
+    free_blocks(owner(s->doors[i]));
+  }
+  free(s);
+}
+
+#endif /* ORDMAIN_DS_DEAMORTIZED */
+
+/*
+  Called when a delete has left ${s} with fewer than a quarter of the
+  limit. If the neighbor it would merge with is less than three
+  quarters full, s is merged into it, and the result still fits.
+  Otherwise the two are evened out, and each ends up with at least
+  three eighths of the limit. Either way, it takes O(limit) deletes to
+  get back here. In the deamortized build, the limit is CAP, and s may
+  be any block but the root.
+*/
+static void
+merge_sublist(struct sublist * const s) {
+  struct list * const l = s->parent;
+  struct sublist * const n = neighbor(s);
+  if (NULL == n) {
+    return;
+  }
+  struct sublist * const left = (n == s->next) ? s : n;
+  struct sublist * const right = (n == s->next) ? n : s;
+  const unsigned total = (unsigned)left->size + right->size;
+  STAT(++l->stats.merges);
+  if (4 * (unsigned)n->size >= 3 * (unsigned)l->limit) {
+    divide(left, right, (log_t)(total / 2));
+    return;
+  }
+  struct ordmain_ds_node * all[2 * BLOCK];
+  gather(right, all + gather(left, all));
+  place(n, all, total);
+  STAT(count_relabeled(n, total));
+  top_delete(s);
+}
+
+/*
+  Creates a list holding one leaf and returns its finger, or NULL if
+  malloc fails.
+*/
+static struct ordmain_ds_node *
+singleton(void) {
+  struct list    * top    = NULL;
+  struct sublist * middle = NULL;
+  struct ordmain_ds_node * ans = NULL;
+
+  top = malloc(sizeof(struct list));
+  if (NULL == top) {
+    goto err;
+  }
+  top->size = 1;
+  top->leaves = 1;
+#ifdef ORDMAIN_DS_DEAMORTIZED
+  top->limit = CAP;
+#else
+  top->limit = MIN_LIMIT;
+#endif
+  top->oneup = FIRST_ONEUP;
+#ifdef ORDMAIN_STATS
+  const struct ordmain_ds_stats zero = {0};
+  top->stats = zero;
+  top->stats.inserts = 1;
+#endif
+
+  middle = new_sublist();
+  if (NULL == middle) {
+    goto err;
+  }
+  top->base.size = 0;
+  top->base.tag = 0;
+  top->base.parent = top;
+  top->base.prev = middle;
+  top->base.next = middle;
+  middle->size = 1;
+  middle->tag = TAG_MAX >> 1;
+  middle->parent = top;
+  middle->prev = &top->base;
+  middle->next = &top->base;
+#ifdef ORDMAIN_DS_DEAMORTIZED
+  top->base.height = 0;
+  top->base.up.home = NULL;
+  middle->height = 0;
+  middle->up.home = NULL;
+  middle->up.slot = 0;
+  top->root = middle;
+#endif
+
+  ans = malloc(sizeof(struct ordmain_ds_node));
+  if (NULL == ans) {
+    goto err;
+  }
+  middle->tags[0] = LOCAL_MAX >> 1;
+  middle->doors[0] = ans;
+  ans->home = middle;
+  ans->slot = 0;
+
+  return ans;
+
+ err:
+
+  errno = ENOMEM;
+  free(top);
+  free(middle);
+  free(ans);
+  return NULL;
+}
+
+/*
+  Puts ${h} in a new slot next to ${x}, in the same block: just after
+  it if ${after}, otherwise just before it. The block is split first
+  if it is full. Returns false on error, with errno set and h not
+  placed.
+*/
+static bool
+slot_in(struct ordmain_ds_node * const x, struct ordmain_ds_node * const h,
+        const bool after) {
+  if (!make_room(x->home)) {
+    return false;
+  }
+  struct sublist * const s = x->home;
+  assert (s->size < BLOCK);
+
+  const unsigned t = s->tags[x->slot];
+  struct gap g;
+  g.lo = after ? t : below(s, t);
+  g.hi = after ? above(s, t) : t;
+  if (g.hi - g.lo < 2) {
+    g = relabel(s, g.lo);
+    STAT(count_relabeled(s, s->size));
+  }
+  assert (g.hi - g.lo >= 2);
+  const log_t slot = s->size;
+  s->tags[slot] = (local_t)(g.lo + (g.hi - g.lo)/2);
+  s->doors[slot] = h;
+  h->home = s;
+  h->slot = slot;
+  ++s->size;
+  return true;
+}
+
+/*
+  Inserts a new leaf next to the leaf of ${x}: just after it if
+  ${after}, otherwise just before it.
+*/
+static struct ordmain_ds_node *
+insert(struct ordmain_ds_node * const x, const bool after) {
+  struct list * const l = x->home->parent;
+  STAT(const uint64_t relabeled = l->stats.relabeled);
+  STAT(const uint64_t top_relabeled = l->stats.top_relabeled);
+
+  struct ordmain_ds_node * const ans = malloc(sizeof(struct ordmain_ds_node));
+  if (NULL == ans) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  if (!slot_in(x, ans, after)) {
+    free(ans);
+    return NULL;
+  }
+  ++l->leaves;
+  STAT(++l->stats.inserts);
+  STAT(count_op(l, relabeled, top_relabeled));
+  return ans;
+}
+
+struct ordmain_ds_node *
+ordmain_ds_insert_after(struct ordmain_ds_node * const x) {
+  if (NULL == x) {
+    return singleton();
+  }
+  return insert(x, true);
+}
+
+struct ordmain_ds_node *
+ordmain_ds_insert_before(struct ordmain_ds_node * const x) {
+  if (NULL == x) {
+    return singleton();
+  }
+  return insert(x, false);
+}
+
+bool
+ordmain_ds_in_order(const struct ordmain_ds_node * const x,
+                    const struct ordmain_ds_node * const y) {
+  if ((NULL == x) || (NULL == y)) {
+    errno = EINVAL;
+    return false;
+  }
+  const struct sublist * const xs = x->home;
+  const struct sublist * const ys = y->home;
+  if (xs == ys) {
+    return xs->tags[x->slot] < xs->tags[y->slot];
+  }
+  const struct list * const l = xs->parent;
+  if (l != ys->parent) {
+    errno = EINVAL;
+    return false;
+  }
+#ifdef ORDMAIN_DS_DEAMORTIZED
+  const struct ordmain_ds_node * u = &xs->up;
+  const struct ordmain_ds_node * v = &ys->up;
+  while (u->home != v->home) {
+    u = &u->home->up;
+    v = &v->home->up;
+  }
+  return u->home->tags[u->slot] < u->home->tags[v->slot];
+#else
+  const tag_t base_tag = l->base.tag;
+  return (tag_t)(xs->tag - base_tag) < (tag_t)(ys->tag - base_tag);
+#endif
+}
+
+static void
+destroy_list(struct list * const l) {
+#ifdef ORDMAIN_DS_DEAMORTIZED
+  free_blocks(l->root);
+#endif
+  struct sublist * const base = &l->base;
+  struct sublist * s = base->next;
+  while (s != base) {
+    struct sublist * const next = s->next;
+    for (log_t i = 0; i < s->size; ++i) {
+      free(s->doors[i]);
+    }
+    free(s);
+    s = next;
+  }
+  free(l);
+}
+
+void
+ordmain_ds_delete(struct ordmain_ds_node * const x) {
+  if (NULL == x) {
+    return;
+  }
+  struct sublist * const s = x->home;
+  struct list * const l = s->parent;
+  STAT(const uint64_t relabeled = l->stats.relabeled);
+  STAT(const uint64_t top_relabeled = l->stats.top_relabeled);
+  unslot(x);
+  --l->leaves;
+  STAT(++l->stats.deletes);
+  free(x);
+  if (0 == l->leaves) {
+    /* The user has no finger into an empty list, so free it now or
+       it will be leaked. */
+    destroy_list(l);
+    return;
+  }
+  if (0 == s->size) {
+    top_delete(s);
+  } else if (4 * (unsigned)s->size < l->limit) {
+    merge_sublist(s);
+  }
+  STAT(count_op(l, relabeled, top_relabeled));
+}
+
+void
+ordmain_ds_destroy_list(struct ordmain_ds_node * const x) {
+  if (NULL == x) {
+    return;
+  }
+  destroy_list(x->home->parent);
+}
+
+int
+ordmain_ds_get_stats(const struct ordmain_ds_node * const x,
+                     struct ordmain_ds_stats * const out) {
+#ifdef ORDMAIN_STATS
+  if ((NULL == x) || (NULL == out)) {
+    errno = EINVAL;
+    return -1;
+  }
+  const struct list * const l = x->home->parent;
+  *out = l->stats;
+  out->limit = l->limit;
+  out->sublists = l->size;
+#ifdef ORDMAIN_DS_DEAMORTIZED
+  out->levels = l->root->height;
+#endif
+  return 0;
+#else
+  (void)x;
+  (void)out;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
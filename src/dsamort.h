@@ -0,0 +1,110 @@
+#ifndef DSAMORT_H
+#define DSAMORT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+An order maintenance list in two levels, after Dietz and Sleator's
+O(1) amortized structure as simplified by Bender et al. The nodes are
+cut into runs, called sublists, of O(log n) nodes each. Each node has
+a tag that orders it within its sublist, and each sublist has a tag
+that orders it within the list. A sublist that fills up is split in
+two, which relabels O(log n) nodes of the bottom level and inserts one
+sublist at the top. That happens only once every O(log n) inserts, so
+the top level's relabels cost O(1) amortized per insert.
+
+A sublist is a single block of up to 64 nodes, aligned to a cache
+line, and tags within it are one byte, so comparing two nodes of the
+same sublist reads one cache line. Sublist counts and tags are 32 and
+64 bits wide, which limits a list to 2^32 - 2 sublists, or upwards of
+50 billion nodes; past that, inserts fail with ENOSPC.
+
+When dsamort.c is built with ORDMAIN_DS_DEAMORTIZED defined, the
+sublists are ordered by a tree of blocks like them instead of by
+tags, and every insert and delete takes worst-case O(1) time: it
+splits or merges at most one block of up to 64 slots per level, and
+a tree over 2^32 sublists has at most 8 levels. Comparing nodes of
+different sublists walks up those levels, so it is slower than in the
+amortized build.
+
+This is a separate backend from the one in order_maintenance.h. The
+two kinds of node cannot be mixed.
+*/
+
+/*
+A node is a finger: a persistent handle to a place in the list. It
+stays valid until it is deleted, however the list is reorganized.
+*/
+struct ordmain_ds_node;
+
+/*
+Returns true when x precedes y in the list.
+*/
+bool ordmain_ds_in_order(const struct ordmain_ds_node * x,
+                         const struct ordmain_ds_node * y);
+
+/*
+Returns a pointer to a newly created node placed just after x. If x
+is NULL, creates a list with a single node, then returns a pointer to
+that node. Returns NULL on error, with errno set to ENOMEM, or to
+ENOSPC if the list has too many sublists.
+*/
+struct ordmain_ds_node *
+ordmain_ds_insert_after(struct ordmain_ds_node * x);
+
+/*
+See ordmain_ds_insert_after.
+*/
+struct ordmain_ds_node *
+ordmain_ds_insert_before(struct ordmain_ds_node * x);
+
+/*
+Removes the node x from the list it belongs to, then frees the memory
+it was using. x must not be used again.
+*/
+void ordmain_ds_delete(struct ordmain_ds_node * x);
+
+/*
+Frees every node in the list that x belongs to, including x. Does
+nothing if x is NULL.
+*/
+void ordmain_ds_destroy_list(struct ordmain_ds_node * x);
+
+/*
+Counters kept per list when dsamort.c is built with ORDMAIN_STATS
+defined. Without it, the counters are not compiled in at all.
+*/
+struct ordmain_ds_stats {
+  uint64_t inserts;
+  uint64_t deletes;
+  /* Existing nodes given new tags within their sublists */
+  uint64_t relabeled;
+  /* Existing sublists given new tags, or in the deamortized build
+     blocks above the sublists, in total and at most in one operation */
+  uint64_t top_relabeled;
+  uint64_t max_top_relabel;
+  /* The most nodes and sublists given new tags by one operation, at
+     both levels */
+  uint64_t max_steps;
+  uint64_t splits;
+  /* Sublists that got too small and were merged into, or evened out
+     with, a neighbor */
+  uint64_t merges;
+  /* The current bound on the size of a sublist */
+  unsigned limit;
+  unsigned sublists;
+  /* In the deamortized build, the levels of blocks above the
+     sublists */
+  unsigned levels;
+};
+
+/*
+Copies the counters of the list x belongs to into *out and returns 0.
+Returns -1 and sets errno to ENOSYS if dsamort.c was built without
+ORDMAIN_STATS, or to EINVAL if x or out is NULL.
+*/
+int ordmain_ds_get_stats(const struct ordmain_ds_node * x,
+                         struct ordmain_ds_stats * out);
+
+#endif /* DSAMORT_H */
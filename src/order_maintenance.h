@@ -2,17 +2,62 @@
 #define ORDER_MAINTENANCE_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 /*
 opaque
 */
 struct ordmain_node;
 
+/*
+Tags are 32 bits wide by default, which limits a list to about 2^16
+nodes. Build with ORDMAIN_WIDE_TAGS defined to use 64-bit tags, which
+allows about 2^32 nodes and leaves more room between tags, so inserts
+relabel less often.
+
+Build with ORDMAIN_COMPACT defined to store each node in 16 bytes or
+less, instead of 32, by linking nodes with 32-bit indices and finding
+the list a node belongs to from the address of the node. Every list
+then takes at least 64KiB.
+
+Build with ORDMAIN_CONCURRENT defined to let one thread insert into
+and delete from a list while other threads call ordmain_in_order and
+ordmain_in_order_batch on its nodes without locking. Readers retry
+when a relabel overlaps them. This needs GCC or Clang.
+
+Build with ORDMAIN_RANK defined to make ordmain_rank and
+ordmain_distance work, in O(log n) expected time. Each list then also
+keeps a balanced tree of its nodes, which makes every node 32 bytes
+larger and adds O(log n) expected time to each insert and delete.
+This cannot be combined with ORDMAIN_COMPACT.
+
+Every file that includes this header must agree on which of these
+are defined.
+*/
+
 #ifndef NDEBUG
+#ifdef ORDMAIN_WIDE_TAGS
+typedef uint64_t tag_t;
+typedef uint32_t count_t;
+#else
 typedef uint32_t tag_t;
 typedef uint16_t count_t;
 typedef uint64_t sqtag_t;
+#endif
+
+#ifdef ORDMAIN_COMPACT
+typedef uint32_t index_t;
 
+struct ordmain_node {
+  tag_t tag;
+  /*
+    The positions of the neighbors in the node table of the list.
+   */
+  index_t prev;
+  index_t next;
+};
+#else
 struct ordmain_node {
   tag_t tag;
   /*
@@ -21,14 +66,46 @@ struct ordmain_node {
   struct ordmain_node * prev; 
   struct ordmain_node * next;
   struct ordmain_node * base;
+#ifdef ORDMAIN_RANK
+  /*
+    The place of the node in the treap kept for ordmain_rank, and the
+    number of nodes in its subtree.
+   */
+  struct ordmain_node * up;
+  struct ordmain_node * kid[2];
+  size_t weight;
+#endif
 };
 #endif
+#endif
 
 /*
 Returns true when x precedes y in the list.
 */
 bool ordmain_in_order(const struct ordmain_node * x, const struct ordmain_node * y);
 
+/*
+Answers n order queries at once: sets out[i] to 1 if xs[i] precedes
+ys[i] and to 0 otherwise, exactly as ordmain_in_order would. The nodes
+of upcoming queries are prefetched while earlier ones are answered,
+so this is much faster than a loop over ordmain_in_order when the
+nodes are not in cache.
+*/
+void ordmain_in_order_batch(const struct ordmain_node * const * xs,
+                            const struct ordmain_node * const * ys,
+                            size_t n, uint8_t * out);
+
+/*
+Sorts nodes[0] through nodes[n-1] into list order. This reads each
+node once and runs in O(n) time, unlike a comparison sort with
+ordmain_in_order.
+
+Returns 0 on success. On error, returns -1, sets errno to ENOMEM, or
+to EINVAL if some node is NULL or the nodes are not all in the same
+list, and leaves the array unchanged.
+*/
+int ordmain_sort(struct ordmain_node ** nodes, size_t n);
+
 /* 
 Returns a pointer to a newly created node placed just after x. Nodes
 are members of only one list. If x is NULL, creates a list with a
@@ -43,11 +120,91 @@ See ordmain_insert_after.
 struct ordmain_node * 
 ordmain_insert_before(struct ordmain_node *);
 
+/*
+Places n new nodes, in order, just after x, and stores pointers to
+them in out[0] through out[n-1] unless out is NULL. If x is NULL,
+creates a new list holding only the n nodes. This relabels each
+existing node at most once, however large n is, and the new nodes
+are adjacent in memory.
+
+Returns 0 on success. On error, returns -1, sets errno to ENOMEM or
+ENOSPC, and leaves the list unchanged.
+*/
+int
+ordmain_insert_n_after(struct ordmain_node * x, size_t n,
+                       struct ordmain_node * out[]);
+
+/*
+Creates a new list of n nodes and stores pointers to them, in list
+order, in out[0] through out[n-1]. This is much faster than building
+the list with n calls to ordmain_insert_after: the nodes are
+allocated as one block, and their tags are spread evenly over the
+whole tag range in a single pass.
+
+Returns 0 on success. On error, returns -1 and sets errno to EINVAL if
+out is NULL, ENOSPC if n is too large for the tag width, or ENOMEM.
+*/
+int ordmain_build(size_t n, struct ordmain_node * out[]);
+
 /*
 Removes the node x from the list it belongs to, then frees the memory it
 was using.
 */
 void ordmain_delete(struct ordmain_node * x); 
 
+/*
+Frees every node in the list that x belongs to, including x. This
+takes time proportional to the memory the list uses, not to the
+number of nodes in it. Does nothing if x is NULL.
+*/
+void ordmain_destroy_list(struct ordmain_node * x);
+
+
+/*
+Counters kept per list when the library is built with ORDMAIN_STATS
+defined. Without it, the counters are not compiled in at all.
+*/
+#define ORDMAIN_STATS_BUCKETS 33
+struct ordmain_stats {
+  uint64_t inserts;
+  uint64_t deletes;
+  /* Calls to ordmain_in_order, plus queries in batches. */
+  uint64_t queries;
+  /* Existing nodes given new tags by inserts, in total and at most in
+     one insert. */
+  uint64_t relabeled;
+  uint64_t max_relabel;
+  /* Bucket 0 counts inserts that relabeled nothing. Bucket b counts
+     inserts that relabeled between 2^(b-1) and 2^b - 1 nodes. */
+  uint64_t relabel_histogram[ORDMAIN_STATS_BUCKETS];
+  /* Memory held by the list, including free nodes. */
+  size_t bytes;
+};
+
+/*
+Copies the counters of the list x belongs to into *out and returns 0.
+Returns -1 and sets errno to ENOSYS if the library was built without
+ORDMAIN_STATS, or to EINVAL if x or out is NULL.
+*/
+int ordmain_get_stats(const struct ordmain_node * x,
+                      struct ordmain_stats * out);
+/*
+Sets *out to the number of nodes before x in its list and returns 0.
+Returns -1 and sets errno to ENOSYS if the library was built without
+ORDMAIN_RANK, or to EINVAL if x or out is NULL.
+
+Like inserts and deletes, this needs the list to itself, even with
+ORDMAIN_CONCURRENT.
+*/
+int ordmain_rank(const struct ordmain_node * x, size_t * out);
+
+/*
+Sets *out to the rank of y minus the rank of x, which is positive when
+x precedes y, and returns 0. Returns -1 and sets errno as
+ordmain_rank does, and also to EINVAL if x and y are in different
+lists.
+*/
+int ordmain_distance(const struct ordmain_node * x,
+                     const struct ordmain_node * y, ptrdiff_t * out);
 
 #endif /* ORDER_MAINTENANCE_H */
@@ -0,0 +1,394 @@
+// A header-only C++ front end for order maintenance.
+//
+// ordmain::list<TagT, Policy, Allocator> keeps the algorithm of
+// baseamort.c: an insert scans forward from the new node's
+// predecessor until the tag range it has passed over is wider than
+// the square of the number of nodes in it, then spreads those nodes
+// evenly over the range. Unlike baseamort.c, the base node never
+// moves. Its tag is always 0, and when a forward scan reaches the end
+// of the list the window grows backward instead. Each tag is then
+// absolute, so in_order is just a comparison of two tags and inlines
+// into the caller.
+//
+// Nodes are owned by the list. Each insert returns a handle, which is
+// move-only and erases its node when it is destroyed. Every handle
+// must be destroyed or released before its list is.
+//
+// Requires C++17.
+
+#ifndef ORDER_MAINTENANCE_HPP
+#define ORDER_MAINTENANCE_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace ordmain {
+
+// The default policy relabels a window of count nodes over a range
+// of width tags while width <= count^2, as baseamort.c does. A policy
+// must report a window as crowded whenever width <= count, so that
+// the new node always has a free tag after a relabel.
+struct default_policy {
+  template<typename T>
+  static constexpr bool crowded(const T width, const T count) noexcept {
+    return width <= count * count;
+  }
+};
+
+template<typename TagT = std::uint64_t,
+         typename Policy = default_policy,
+         typename Allocator = std::allocator<std::byte> >
+class list {
+  static_assert(std::is_integral<TagT>::value
+                && std::is_unsigned<TagT>::value,
+                "tags must be an unsigned integer type");
+
+public:
+  typedef TagT tag_type;
+  typedef Policy policy_type;
+  typedef Allocator allocator_type;
+  typedef std::size_t size_type;
+
+  static constexpr int tag_bits = std::numeric_limits<TagT>::digits;
+  static constexpr TagT tag_max = std::numeric_limits<TagT>::max();
+
+  // The largest number of nodes a list can hold. It keeps count^2 in
+  // a TagT during the scans in insert_after.
+  static constexpr size_type max_nodes =
+    (static_cast<size_type>(1) << (tag_bits / 2 < 63 ? tag_bits / 2 : 63))
+    - 2;
+
+  class node {
+    friend class list;
+    TagT tag_;
+    node * prev_;
+    node * next_;
+
+  public:
+    node() = default;
+    node(const node &) = delete;
+    node & operator=(const node &) = delete;
+
+    TagT tag() const noexcept { return tag_; }
+  };
+
+  // Is x before y? Both must be in the same list.
+  static bool in_order(const node & x, const node & y) noexcept {
+    return x.tag_ < y.tag_;
+  }
+
+private:
+  typedef std::allocator_traits<Allocator> traits;
+  typedef typename traits::template rebind_alloc<node> node_allocator;
+  typedef std::allocator_traits<node_allocator> node_traits;
+
+  // The state of a list lives in one allocation, so that moving a list
+  // does not invalidate its handles.
+  struct root {
+    node base;
+    size_type size;
+    node_allocator alloc;
+
+    explicit root(const Allocator & a) : size(0), alloc(a) {
+      base.tag_ = 0;
+      base.prev_ = &base;
+      base.next_ = &base;
+    }
+  };
+
+  typedef typename traits::template rebind_alloc<root> root_allocator;
+  typedef std::allocator_traits<root_allocator> root_traits;
+
+  root * root_;
+
+public:
+  class const_iterator {
+    friend class list;
+    const node * x_;
+
+    explicit const_iterator(const node * x) noexcept : x_(x) {}
+
+  public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef node value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const node * pointer;
+    typedef const node & reference;
+
+    const_iterator() noexcept : x_(nullptr) {}
+
+    reference operator*() const noexcept { return *x_; }
+    pointer operator->() const noexcept { return x_; }
+
+    const_iterator & operator++() noexcept {
+      x_ = x_->next_;
+      return *this;
+    }
+    const_iterator operator++(int) noexcept {
+      const const_iterator ans = *this;
+      x_ = x_->next_;
+      return ans;
+    }
+    const_iterator & operator--() noexcept {
+      x_ = x_->prev_;
+      return *this;
+    }
+    const_iterator operator--(int) noexcept {
+      const const_iterator ans = *this;
+      x_ = x_->prev_;
+      return ans;
+    }
+
+    friend bool operator==(const const_iterator a, const const_iterator b)
+      noexcept {
+      return a.x_ == b.x_;
+    }
+    friend bool operator!=(const const_iterator a, const const_iterator b)
+      noexcept {
+      return a.x_ != b.x_;
+    }
+  };
+
+  // Nodes cannot be changed through iterators, so both are the same.
+  typedef const_iterator iterator;
+
+  class handle {
+    friend class list;
+    root * root_;
+    node * x_;
+
+    handle(root * r, node * x) noexcept : root_(r), x_(x) {}
+
+  public:
+    handle() noexcept : root_(nullptr), x_(nullptr) {}
+    handle(const handle &) = delete;
+    handle & operator=(const handle &) = delete;
+
+    handle(handle && that) noexcept : root_(that.root_), x_(that.x_) {
+      that.root_ = nullptr;
+      that.x_ = nullptr;
+    }
+
+    handle & operator=(handle && that) noexcept {
+      if (this != &that) {
+        reset();
+        std::swap(root_, that.root_);
+        std::swap(x_, that.x_);
+      }
+      return *this;
+    }
+
+    ~handle() { reset(); }
+
+    const node & operator*() const noexcept { return *x_; }
+    const node * operator->() const noexcept { return x_; }
+    const node * get() const noexcept { return x_; }
+    explicit operator bool() const noexcept { return nullptr != x_; }
+
+    // Erases the node, if any, and leaves the handle empty.
+    void reset() noexcept {
+      if (nullptr != x_) {
+        list::erase(root_, x_);
+        root_ = nullptr;
+        x_ = nullptr;
+      }
+    }
+
+    // Leaves the node in the list, but no longer owned by this handle.
+    // It can be erased with list::erase, or is freed with the list.
+    const node * release() noexcept {
+      const node * const ans = x_;
+      root_ = nullptr;
+      x_ = nullptr;
+      return ans;
+    }
+  };
+
+  list() : list(Allocator()) {}
+
+  explicit list(const Allocator & a) {
+    root_allocator ra(a);
+    root_ = root_traits::allocate(ra, 1);
+    root_traits::construct(ra, root_, a);
+  }
+
+  list(const list &) = delete;
+  list & operator=(const list &) = delete;
+
+  list(list && that) noexcept : root_(that.root_) {
+    that.root_ = nullptr;
+  }
+
+  list & operator=(list && that) noexcept {
+    std::swap(root_, that.root_);
+    return *this;
+  }
+
+  // Frees every node still in the list.
+  ~list() {
+    if (nullptr == root_) {
+      return;
+    }
+    node * x = root_->base.next_;
+    while (x != &root_->base) {
+      node * const next = x->next_;
+      node_traits::destroy(root_->alloc, x);
+      node_traits::deallocate(root_->alloc, x, 1);
+      x = next;
+    }
+    root_allocator ra(root_->alloc);
+    root_traits::destroy(ra, root_);
+    root_traits::deallocate(ra, root_, 1);
+  }
+
+  allocator_type get_allocator() const {
+    return allocator_type(root_->alloc);
+  }
+
+  size_type size() const noexcept { return root_->size; }
+  bool empty() const noexcept { return 0 == root_->size; }
+
+  const_iterator begin() const noexcept {
+    return const_iterator(root_->base.next_);
+  }
+  const_iterator end() const noexcept {
+    return const_iterator(&root_->base);
+  }
+
+  const_iterator iterator_to(const node & x) const noexcept {
+    return const_iterator(&x);
+  }
+
+  static bool in_order(const const_iterator x, const const_iterator y)
+    noexcept {
+    return in_order(*x, *y);
+  }
+
+  static bool in_order(const handle & x, const handle & y) noexcept {
+    return in_order(*x, *y);
+  }
+
+  // Inserts a node just after x, which may be *end() to insert at the
+  // front. Throws std::length_error if the list already holds
+  // max_nodes nodes, and whatever the allocator throws.
+  [[nodiscard]] handle insert_after(const node & x) {
+    if (root_->size >= max_nodes) {
+      throw std::length_error("ordmain::list is full");
+    }
+    node * const h = node_traits::allocate(root_->alloc, 1);
+    node_traits::construct(root_->alloc, h);
+    node * const at = const_cast<node *>(&x);
+    make_room_after(at);
+    node * const after = at->next_;
+    h->tag_ = midpoint(at);
+    assert (h->tag_ != at->tag_);
+    assert (h->tag_ != after->tag_);
+    h->prev_ = at;
+    h->next_ = after;
+    after->prev_ = h;
+    at->next_ = h;
+    ++root_->size;
+    return handle(root_, h);
+  }
+
+  [[nodiscard]] handle insert_before(const node & x) {
+    return insert_after(*x.prev_);
+  }
+
+  [[nodiscard]] handle push_front() { return insert_after(root_->base); }
+  [[nodiscard]] handle push_back() { return insert_after(*root_->base.prev_); }
+
+  // Erases a node that was released from its handle.
+  void erase(const node * const x) noexcept {
+    erase(root_, const_cast<node *>(x));
+  }
+
+private:
+  static void erase(root * const r, node * const x) noexcept {
+    assert (x != &r->base);
+    x->prev_->next_ = x->next_;
+    x->next_->prev_ = x->prev_;
+    node_traits::destroy(r->alloc, x);
+    node_traits::deallocate(r->alloc, x, 1);
+    --r->size;
+  }
+
+  // A tag halfway between x and its successor. The base closes the
+  // list, so after the last node it stands for 2^tag_bits.
+  TagT midpoint(const node * const x) const noexcept {
+    if (x->next_ == &root_->base) {
+      return x->tag_ + (tag_max - x->tag_) / 2 + 1;
+    }
+    return x->tag_ + static_cast<TagT>(x->next_->tag_ - x->tag_) / 2;
+  }
+
+  // w * k / j, without overflow, for 0 < k < j.
+  static TagT spread(const TagT w, const TagT k, const TagT j) noexcept {
+    assert (0 < k);
+    assert (k < j);
+    const TagT q = w / j;
+    const TagT r = w % j;
+    return q * k + (r * k) / j;
+  }
+
+  // Gives the nodes in the open range (from, to) tags evenly spread
+  // over the range, which is ${width} wide and holds j - 1 nodes.
+  static void relabel(node * const from, const TagT width, const TagT j) {
+    node * xk = from->next_;
+    for (TagT k = 1; k < j; ++k) {
+      xk->tag_ = from->tag_ + spread(width, k, j);
+      xk = xk->next_;
+    }
+  }
+
+  // Makes sure there is a free tag between x and its successor.
+  void make_room_after(node * const x) {
+    node * const b = &root_->base;
+    // Scan forward, as baseamort.c does, but stop at the end of the
+    // list.
+    TagT j = 1;
+    node * xj = x->next_;
+    while (xj != b) {
+      const TagT wj = xj->tag_ - x->tag_;
+      if (!Policy::crowded(wj, j)) {
+        relabel(x, wj, j);
+        return;
+      }
+      ++j;
+      xj = xj->next_;
+    }
+    // The window (x, end) is crowded, so grow it backward until it is
+    // not. The whole list never is, since it has fewer than
+    // 2^(tag_bits/2) nodes, so this stops at the base at the latest,
+    // and the base itself is never relabeled.
+    node * z = x;
+    TagT wz = (z == b) ? tag_max : static_cast<TagT>(0 - z->tag_);
+    while ((z != b) && Policy::crowded(wz, j)) {
+      z = z->prev_;
+      ++j;
+      wz = (z == b) ? tag_max : static_cast<TagT>(0 - z->tag_);
+    }
+    assert (!Policy::crowded(wz, j));
+    relabel(z, wz, j);
+  }
+};
+
+namespace pmr {
+
+template<typename TagT = std::uint64_t, typename Policy = default_policy>
+using list = ordmain::list<TagT, Policy,
+                           std::pmr::polymorphic_allocator<std::byte> >;
+
+}
+
+}
+
+#endif
@@ -0,0 +1,1009 @@
+/*
+
+A general balanced tree (Andersson 1989) is a binary search tree of logarithmic height maintained by partial rebuilding.
+Each
+
+The depth bound is not fixed. Each list loosens it when rebalancing
+costs too much, and tightens it when tags get close to running out,
+then rebuilds itself globally.
+
+ */
+
+#include "scapegoat.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+/*
+  Tags are 64 bits wide by default. Building with ORDMAIN_SG_WIDE_TAGS
+  defined makes them 128 bits wide, for lists that grow past about
+  2^32 nodes, or that would otherwise use up the bits of a tag under
+  skewed inserts.
+*/
+#ifdef ORDMAIN_SG_WIDE_TAGS
+#ifndef __SIZEOF_INT128__
+#error "ORDMAIN_SG_WIDE_TAGS needs a compiler with unsigned __int128"
+#endif
+__extension__ typedef unsigned __int128 count_t;
+#else
+typedef uint64_t count_t;
+#endif
+// log_t represents the log_2 of a count_t.
+// It is always between 0 and b, where b is the number of bits in a
+// count_t.
+typedef uint8_t log_t;
+
+// ceiling is the number of bits in a count_t
+static const log_t ceiling = sizeof(count_t) << 3;
+
+/*
+A tree with n leaves has 2n-1 nodes. It must have height <=
+slop/SLOP_UNIT * log_2 n. Each root keeps its own slop between SLOP_MIN
+and SLOP_MAX, starting at SLOP_DEFAULT, which is Andersson's bound of
+twice the logarithm. Building with ORDMAIN_SG_SLOP defined fixes slop
+at that value instead.
+ */
+#define SLOP_UNIT 4
+/* Below twice the logarithm, a subtree can be out of balance even
+   right after it was rebalanced, and inserts in one place run out of
+   tags. */
+#define SLOP_MIN 8
+#define SLOP_MAX 16
+#ifdef ORDMAIN_SG_SLOP
+#define SLOP_DEFAULT ORDMAIN_SG_SLOP
+#else
+#define SLOP_DEFAULT 8
+#endif
+
+struct root;
+
+struct ordmain_sg_node {
+  count_t tag;
+  struct ordmain_sg_node * left;
+  struct ordmain_sg_node * right;
+  struct root * root;
+  /* The last bit set when creating this node, or ceiling if no bits
+     were set. This value is necessarily between 0 and ceiling. */
+  log_t elevation;
+  bool deleted;
+  /* Which side of an incremental rebuild this node is on; see
+     begin_rebuild. */
+  bool epoch;
+};
+
+/*
+  Nodes are not allocated one at a time. Each root owns a chain of
+  chunks, and nodes are carved from the newest chunk in order.
+  Detached nodes go on a per-root free list and are reused by later
+  inserts. Memory is only returned to malloc when the whole list is
+  freed.
+*/
+
+#define CACHE_LINE 64
+/* Chunks start small, so that short lists stay cheap, and double in
+   size up to MAX_CHUNK_NODES. */
+#define MIN_CHUNK_NODES 16
+#define MAX_CHUNK_NODES 4096
+
+/* A chunk header is followed by its nodes, which start at the first
+   cache line boundary after the header. */
+struct chunk {
+  struct chunk * next;
+};
+
+struct root {
+  // The largest size the tree has ever been
+  count_t largest;
+  // The number of dead nodes
+  count_t deletes;
+  struct ordmain_sg_node * first;
+  /* While a rebuild is in progress, the first node the sweep has not
+     reached yet. NULL otherwise. */
+  struct ordmain_sg_node * cursor;
+  /* The epoch of nodes the sweep has passed */
+  bool epoch;
+  /* The elevation the sweep gives the nodes it passes */
+  log_t sweep_elevation;
+  /* The depth bound; see SLOP_UNIT */
+  log_t slop;
+  /* Inserts, and nodes given new tags by rebalancing, since slop was
+     last reconsidered */
+  count_t recent_inserts;
+  count_t recent_moved;
+  struct chunk * chunks;
+  /* Nodes in [fresh, limit) have never been handed out. */
+  struct ordmain_sg_node * fresh;
+  struct ordmain_sg_node * limit;
+  /* Nodes that were detached, linked through ${right}. */
+  struct ordmain_sg_node * recycled;
+  size_t next_chunk_nodes;
+#ifdef ORDMAIN_STATS
+  struct ordmain_sg_stats stats;
+#endif
+};
+
+/*
+  STAT(statement) runs statement only in builds with ORDMAIN_STATS
+  defined, so that the counters cost nothing otherwise.
+*/
+#ifdef ORDMAIN_STATS
+#define STAT(statement) statement
+#else
+#define STAT(statement)
+#endif
+
+/*
+  Adds a chunk of root->next_chunk_nodes nodes to the root and makes
+  it the source of fresh nodes. Any fresh nodes left in the old chunk
+  are put on the free list first. Returns false if allocation fails.
+*/
+static bool
+grow(struct root * const root) {
+  const size_t many = root->next_chunk_nodes;
+  struct chunk * const c = malloc(CACHE_LINE + many * sizeof(struct ordmain_sg_node));
+  if (NULL == c) {
+    return false;
+  }
+  while (root->fresh != root->limit) {
+    root->fresh->right = root->recycled;
+    root->recycled = root->fresh;
+    ++root->fresh;
+  }
+  c->next = root->chunks;
+  root->chunks = c;
+  root->fresh = (struct ordmain_sg_node *)((char *)c + CACHE_LINE);
+  root->limit = root->fresh + many;
+  if (root->next_chunk_nodes < MAX_CHUNK_NODES) {
+    root->next_chunk_nodes *= 2;
+  }
+  return true;
+}
+
+/*
+  Returns an uninitialized node from ${root}, or NULL on error.
+*/
+static struct ordmain_sg_node *
+alloc_node(struct root * const root) {
+  if (NULL != root->recycled) {
+    struct ordmain_sg_node * const ans = root->recycled;
+    root->recycled = ans->right;
+    return ans;
+  }
+  if ((root->fresh == root->limit) && !grow(root)) {
+    return NULL;
+  }
+  return root->fresh++;
+}
+
+static void
+free_node(struct ordmain_sg_node * const x) {
+  struct root * const root = x->root;
+  x->right = root->recycled;
+  root->recycled = x;
+}
+
+/*
+  Frees every chunk of the root, then the root itself.
+*/
+static void
+destroy_root(struct root * const root) {
+  struct chunk * c = root->chunks;
+  while (NULL != c) {
+    struct chunk * const next = c->next;
+    free(c);
+    c = next;
+  }
+  free(root);
+}
+
+static struct root *
+make_root(void) {
+  struct root * const root = malloc(sizeof(struct root));
+  if (NULL == root) {
+    return NULL;
+  }
+  root->largest = 0;
+  root->deletes = 0;
+  root->first = NULL;
+  root->cursor = NULL;
+  root->epoch = false;
+  root->sweep_elevation = 0;
+  root->slop = SLOP_DEFAULT;
+  root->recent_inserts = 0;
+  root->recent_moved = 0;
+  root->chunks = NULL;
+  root->fresh = NULL;
+  root->limit = NULL;
+  root->recycled = NULL;
+  root->next_chunk_nodes = MIN_CHUNK_NODES;
+#ifdef ORDMAIN_STATS
+  memset(&root->stats, 0, sizeof(root->stats));
+  root->stats.slop = root->slop;
+  root->stats.min_elevation = ceiling;
+#endif
+  return root;
+}
+
+bool
+ordmain_sg_in_order(const struct ordmain_sg_node * x, const struct ordmain_sg_node * y) {
+  assert (x->root == y->root);
+  if (x->epoch != y->epoch) {
+    // Nodes the sweep has passed come before all the others.
+    return x->epoch == x->root->epoch;
+  }
+  return x->tag < y->tag;
+}
+
+static log_t
+min_log(const log_t x, const log_t y) {
+  return (x < y) ? x : y;
+}
+
+struct valley {
+  log_t min_elevation;
+  count_t width_increase;
+  // How many of the new nodes are deleted
+  count_t dead_increase;
+};
+
+#ifndef NDEBUG
+/* Only assertions use this. */
+static count_t
+mask_greater_eq(const log_t pos) {
+  assert (pos < ceiling);
+  const count_t mask_here = ((count_t)1) << pos;
+  const count_t mask_less = mask_here - 1;
+  return ~mask_less;
+}
+#endif
+
+static count_t
+mask_greater(const log_t pos) {
+  assert (pos < ceiling);
+  const count_t mask_here = ((count_t)1) << pos;
+  const count_t mask_less = mask_here - 1;
+  const count_t mask_lesseq = (mask_less << 1) + 1;
+  return ~mask_lesseq;
+}
+
+
+static void
+max_span(const struct ordmain_sg_node * low, const count_t length, const log_t this_elev, const count_t path_to_root) {
+#ifndef NDEBUG
+  const struct ordmain_sg_node * x = low;
+  for(count_t i = 0; i < length; ++i) {
+    assert (path_to_root == (low->tag & mask_greater(this_elev)));
+    low = low->right;
+  }
+  if (low != NULL && low->epoch == x->epoch) {
+    assert (path_to_root != (low->tag & mask_greater(this_elev)));
+  }
+  low = x->left;
+  if (low != NULL && low->epoch == x->epoch) {
+    assert (path_to_root != (low->tag & mask_greater(this_elev)));
+  }
+#else
+  (void)low;
+  (void)length;
+  (void)this_elev;
+  (void)path_to_root;
+#endif
+}
+
+
+/*
+
+on output, *low to *high must be the largest contiguous region sharing
+the path to root of any member above elevation.
+
+ */
+static struct valley
+expand_once(struct ordmain_sg_node ** low, struct ordmain_sg_node ** high, const log_t elevation) {
+  struct valley ans = {ceiling, 0, 0};
+  assert (elevation < ceiling);
+  const count_t mask = mask_greater(elevation);
+  // the high-order bits of every tag in the range we are searching for
+  const count_t path_to_root = (*low)->tag & mask;
+  // Tags are only comparable within an epoch.
+  const bool epoch = (*low)->epoch;
+  while ((*low)->left
+	 && epoch == (*low)->left->epoch
+	 && path_to_root == (((*low)->left->tag) & mask)) {
+    *low = (*low)->left;
+    ++ans.width_increase;
+    ans.dead_increase += (*low)->deleted;
+    ans.min_elevation = min_log(ans.min_elevation, (*low)->elevation);
+  }
+  while (*high
+	 && epoch == (*high)->epoch
+	 && path_to_root == (((*high)->tag) & mask)) {
+
+    ++ans.width_increase;
+    ans.dead_increase += (*high)->deleted;
+    ans.min_elevation = min_log(ans.min_elevation, (*high)->elevation);
+    *high = (*high)->right;
+  }
+  return ans;
+}
+
+static void
+check_from(const struct ordmain_sg_node * low, const count_t many) {
+#ifndef NDEBUG
+  const struct ordmain_sg_node * x = low;
+  for (count_t i = 0; i < many-1; ++i) {
+    assert (x->epoch == x->right->epoch);
+    assert (x->tag < x->right->tag);
+    if (!(x->tag & (((count_t)1) << x->elevation))) {
+      assert (x->tag + (((count_t)1) << x->elevation) == x->right->tag);
+    }
+
+    x = x->right;
+  }
+#else
+  (void)low;
+  (void)many;
+#endif
+}
+
+static void
+check_until(const struct ordmain_sg_node * low) {
+#ifndef NDEBUG
+  const struct ordmain_sg_node * x = low;
+  while (x && x->right) {
+    if (x->epoch != x->right->epoch) {
+      // The end of the part of the list the sweep has passed
+      assert (x->epoch == x->root->epoch);
+      assert (x->right == x->root->cursor);
+    } else {
+      assert (x->tag < x->right->tag);
+      if (!(x->tag & (((count_t)1) << x->elevation))) {
+        assert (x->tag + (((count_t)1) << x->elevation) == x->right->tag);
+      }
+    }
+    x = x->right;
+  }
+#else
+  (void)low;
+#endif
+}
+
+static void
+detach(struct ordmain_sg_node * x) {
+  if (NULL == x) {
+    return;
+  } else {
+    if (NULL != x->left) {
+      x->left->right = x->right;
+    }
+    if (NULL != x->right) {
+      x->right->left = x->left;
+    }
+    if (x == x->root->first) {
+      x->root->first = x->right;
+    }
+    free_node(x);
+  }
+}
+
+/*
+  Detaches the deleted node x for good, and returns the node after it.
+*/
+static struct ordmain_sg_node *
+reclaim(struct ordmain_sg_node * x) {
+  assert (x->deleted);
+  struct root * const root = x->root;
+  struct ordmain_sg_node * const next = x->right;
+  if (x == root->cursor) {
+    root->cursor = next;
+  }
+  detach(x);
+  root->largest -= 1;
+  root->deletes -= 1;
+  return next;
+}
+
+/*
+  Returns the first live node at or after x, detaching the deleted
+  nodes before it. Rebalancing calls this as it hands out new tags, so
+  that the tag space dead nodes held goes to the live ones.
+*/
+static struct ordmain_sg_node *
+skip_dead(struct ordmain_sg_node * x) {
+  while (x->deleted) {
+    x = reclaim(x);
+  }
+  return x;
+}
+
+#ifndef NDEBUG
+/*
+  Asserts that the ${many} nodes from low have the tags a recursive
+  split would give them, and returns the node after them. redistribute
+  must agree with it bit for bit.
+*/
+static const struct ordmain_sg_node *
+check_spread(const struct ordmain_sg_node * low, const log_t level, const count_t many, const count_t path_to_root) {
+  if (1 == many) {
+    assert (low->tag == path_to_root);
+    assert (low->elevation == (log_t)(level + 1));
+    return low->right;
+  }
+  low = check_spread(low, level-1, many/2, path_to_root);
+  return check_spread(low, level-1, many - many/2, path_to_root + (((count_t)1) << level));
+}
+#endif
+
+/*
+  Gives the first ${many} live nodes from low on evenly spread tags in
+  the subtree at ${path_to_root}, detaching any deleted nodes among
+  them, and returns the node after the last one.
+
+  The first many/2 nodes go in the lower half of the subtree and the
+  rest in the upper half, and so on down, until a node has a part to
+  itself. It then takes the start of that part, and its elevation is
+  the level just above the part. This walks the nodes once, in order,
+  keeping the upper halves still to fill on a stack. Each split
+  lowers the level, so the stack holds at most one part per level.
+*/
+static struct ordmain_sg_node *
+redistribute(struct ordmain_sg_node * low, const log_t level, const count_t many, const count_t path_to_root) {
+  // level is the top level nodes will differ at. It is between 0 and ceiling-1
+  assert (many > 1);
+  struct part {
+    count_t many;
+    count_t path_to_root;
+    // One below 0 wraps around, but only for parts of one node, whose
+    // elevation wraps back to 0.
+    log_t level;
+  };
+  struct part todo[sizeof(count_t) << 3];
+  size_t waiting = 0;
+  struct part here = {many, path_to_root, level};
+  for (;;) {
+    while (here.many > 1) {
+      const count_t half = here.many >> 1;
+      assert (waiting < sizeof(todo) / sizeof(todo[0]));
+      todo[waiting].many = here.many - half;
+      todo[waiting].path_to_root = here.path_to_root + (((count_t)1) << here.level);
+      todo[waiting].level = here.level - 1;
+      ++waiting;
+      here.many = half;
+      here.level -= 1;
+    }
+    low = skip_dead(low);
+    low->tag = here.path_to_root;
+    low->elevation = here.level + 1;
+    low = low->right;
+    if (0 == waiting) {
+      return low;
+    }
+    here = todo[--waiting];
+  }
+}
+
+/*
+  Redistributes the ${many} live nodes from low within the subtree
+  above level, and returns the node after the last one.
+*/
+static struct ordmain_sg_node *
+distribute(struct ordmain_sg_node * low, const log_t level, const count_t many) {
+  // The subtree starts at the prefix above level. low need not be at
+  // the start, when the sweep of a rebuild has taken the nodes before
+  // it.
+  const count_t high_mask = mask_greater(level);
+  low = skip_dead(low);
+  const count_t path_to_root = high_mask & low->tag;
+  struct ordmain_sg_node * const ans =
+    redistribute(low, level, many, path_to_root);
+  check_from(low, many);
+#ifndef NDEBUG
+  assert (ans == check_spread(low, level, many, path_to_root));
+#endif
+  return ans;
+}
+
+
+static bool
+in_balance(const log_t height, const count_t size, const log_t slop) {
+  // height <= slop / SLOP_UNIT * log size
+  // height * SLOP_UNIT / slop <= log size
+  // 2^(height * SLOP_UNIT / slop) <= size
+  const unsigned exponent = (height * SLOP_UNIT) / slop;
+  if (exponent < ceiling) {
+    const count_t low = ((count_t)1) << exponent;
+    return (low <= size);
+  } else {
+    return false;
+  }
+}
+
+static void
+rebalance(struct ordmain_sg_node * x) {
+  // take larger and larger contiguous subsets. Once one is too small, rebalance it
+  struct root * const root = x->root;
+  struct ordmain_sg_node * y = x->right;
+  count_t many = 1;
+  count_t dead = 0;
+  log_t current_elevation = x->elevation;
+  log_t lowest_elevation = x->elevation;
+  if (0 < current_elevation) {
+    max_span(x, many, current_elevation-1, x->tag & mask_greater(current_elevation-1));
+  }
+  while (current_elevation < ceiling
+	 && in_balance(current_elevation - lowest_elevation + 1, many, root->slop)) {
+    struct valley change = expand_once(&x, &y, current_elevation);
+    lowest_elevation = min_log(lowest_elevation, change.min_elevation);
+    many += change.width_increase;
+    dead += change.dead_increase;
+    max_span(x, many, current_elevation, x->tag & mask_greater(current_elevation));
+    ++current_elevation;
+  }
+  assert (0 < current_elevation);
+  max_span(x, many, current_elevation-1, x->tag & mask_greater(current_elevation-1));
+  // current elevation is now the lowest level that the followers of x agree on
+#ifndef NDEBUG
+  if (y && y->epoch == x->epoch) {
+    // The start of the subtree, which is x->tag unless the sweep has
+    // taken the nodes before x
+    const count_t start = x->tag & mask_greater_eq(current_elevation);
+    assert (y->tag - start >= (((count_t)1) << (current_elevation)));
+    assert (y->left->tag - start < (((count_t)1) << (current_elevation)));
+  }
+#endif
+  // The deleted nodes in the window are freed on the way. A rebalance
+  // starts from a node just inserted next to a live one, and both are
+  // in the window, so at least two nodes are left.
+  assert (many - dead >= 2);
+  root->recent_moved += many - dead;
+  STAT(root->stats.relabeled += many - dead);
+  struct ordmain_sg_node * z = distribute(x, current_elevation-1, many - dead);
+  while (z != y) {
+    z = reclaim(z);
+  }
+}
+
+
+
+static void
+maybe_rebalance(struct ordmain_sg_node * x) {
+  const log_t height = ceiling - x->elevation;
+  if (!in_balance(height, x->root->largest, x->root->slop)) {
+    rebalance(x);
+  }
+}
+
+/*
+  Incremental rebuilding.
+
+  Once half the nodes in a list are deleted, the list is rebuilt, but
+  not all at once. begin_rebuild flips the epoch of the root, which
+  leaves every node on the old side, and starts a cursor at the front
+  of the list. Each insert and delete after that moves the cursor
+  over SWEEP_STEPS nodes. The sweep detaches deleted nodes, and gives
+  each live node the next free tag in a fresh tag space, at the
+  elevation the root chose when the rebuild began, and the new epoch.
+
+  So at any time the list is a swept prefix and an unswept suffix,
+  each with its own tags. ordmain_sg_in_order puts every swept node
+  before every unswept one, and rebalancing never crosses from one to
+  the other. Inserts and deletes work on either side as usual. Nodes
+  that are deleted before the sweep reaches them stay in place until
+  it, or a rebalance, does.
+
+  The sweep gains at least SWEEP_STEPS - 1 nodes on the list per
+  operation, so it finishes after a number of operations proportional
+  to the size of the list, long before another rebuild is due. In the
+  rare case that rebalancing among the swept nodes has used up the
+  fresh tag space, the rest of the rebuild is done at once. Small
+  lists are always rebuilt at once.
+*/
+
+#define SWEEP_STEPS 4
+/* The fresh tag space has room for 2^SWEEP_HEADROOM times as many
+   nodes as the list had when the rebuild began. More headroom leaves
+   the swept nodes deeper in the tree, which makes later rebalances
+   climb higher. */
+#define SWEEP_HEADROOM 1
+#define SYNC_REBUILD 256
+
+/*
+  The number of bits needed to write n.
+*/
+static log_t
+bit_length(count_t n) {
+  log_t ans = 0;
+  for (; 0 != n; n >>= 1) {
+    ++ans;
+  }
+  return ans;
+}
+
+static void
+begin_rebuild(struct root * const root) {
+  assert (NULL == root->cursor);
+  STAT(++root->stats.rebuilds);
+  const log_t bits = bit_length(root->largest);
+  assert (bits + SWEEP_HEADROOM < ceiling);
+  root->sweep_elevation = ceiling - SWEEP_HEADROOM - bits;
+  root->epoch = !root->epoch;
+  root->cursor = root->first;
+}
+
+/*
+  Moves the cursor over one node. Returns false, without moving it, if
+  there is no fresh tag left for the node.
+*/
+static bool
+sweep_one(struct root * const root) {
+  struct ordmain_sg_node * const u = root->cursor;
+  assert (u->epoch != root->epoch);
+  if (u->deleted) {
+    // This moves the cursor too.
+    reclaim(u);
+    return true;
+  }
+  // Everything before the cursor has been swept, so the next free tag
+  // is just past the range the last swept node covers.
+  const struct ordmain_sg_node * const last = u->left;
+  count_t tag = 0;
+  if (NULL != last) {
+    assert (last->epoch == root->epoch);
+    tag = last->tag + (((count_t)1) << last->elevation);
+    if (tag <= last->tag) {
+      return false;
+    }
+  }
+  assert (0 == (tag & ((((count_t)1) << root->sweep_elevation) - 1)));
+  u->tag = tag;
+  u->elevation = root->sweep_elevation;
+  u->epoch = root->epoch;
+  root->cursor = u->right;
+  return true;
+}
+
+static void rebuild(struct ordmain_sg_node * x);
+
+/*
+  Does this operation's share of a rebuild in progress, if any.
+*/
+static void
+sweep(struct root * const root) {
+  for (unsigned i = 0; (i < SWEEP_STEPS) && (NULL != root->cursor); ++i) {
+    if (!sweep_one(root)) {
+      rebuild(root->cursor);
+      return;
+    }
+  }
+}
+
+/*
+  Adapting the depth bound.
+
+  A looser bound means fewer and smaller rebalances, but deeper
+  paths, which use up the bits of a tag faster. After every
+  max(largest/2, ADAPT_PERIOD) inserts, the root compares the nodes
+  its rebalances moved with the inserts. If they moved more than
+  1/LOOSEN_COST of log_2 largest per insert, slop goes up by one, as
+  long as the deepest path the new bound allows still leaves
+  SLOP_MARGIN bits of every tag free. If the list has grown so that
+  it no longer does, or an insert leaves a node with fewer than
+  SLOP_MARGIN free bits, slop goes down by one. Either change is
+  followed by a global rebuild, so the list starts over from
+  balanced tags. The period is proportional to the size of the list,
+  so the rebuilds add a constant amortized cost per insert.
+*/
+
+#define ADAPT_PERIOD 1024
+#define LOOSEN_COST 2
+#define SLOP_MARGIN 8
+
+/*
+  Counts an insert that left a node at ${elevation}, and changes
+  the depth bound of the root if it is due.
+*/
+static void
+adapt(struct root * const root, const log_t elevation) {
+  STAT(++root->stats.inserts);
+  STAT(root->stats.min_elevation = min_log(root->stats.min_elevation, elevation));
+  ++root->recent_inserts;
+#ifdef ORDMAIN_SG_SLOP
+  (void)elevation;
+#else
+  if (NULL != root->cursor) {
+    // A rebuild is already under way.
+    return;
+  }
+  log_t slop = root->slop;
+  if (elevation < SLOP_MARGIN) {
+    if (slop > SLOP_MIN) {
+      --slop;
+    }
+  } else if ((root->recent_inserts << 1) >= root->largest
+             && root->recent_inserts >= ADAPT_PERIOD) {
+    // The deepest paths slop can allow, in units of 1/SLOP_UNIT bit
+    const log_t bits = bit_length(root->largest);
+    const unsigned room = SLOP_UNIT * (ceiling - SLOP_MARGIN);
+    if ((unsigned)slop * bits > room) {
+      if (slop > SLOP_MIN) {
+        --slop;
+      }
+    } else if ((root->recent_moved * LOOSEN_COST
+                > root->recent_inserts * bits)
+               && (slop < SLOP_MAX)
+               && ((unsigned)(slop + 1) * bits <= room)) {
+      ++slop;
+    }
+    root->recent_inserts = 0;
+    root->recent_moved = 0;
+  }
+  if (slop == root->slop) {
+    return;
+  }
+  root->slop = slop;
+  root->recent_inserts = 0;
+  root->recent_moved = 0;
+  STAT(++root->stats.slop_changes);
+  STAT(root->stats.slop = slop);
+  if (root->largest < SYNC_REBUILD) {
+    STAT(++root->stats.rebuilds);
+    rebuild(root->first);
+  } else {
+    begin_rebuild(root);
+  }
+#endif
+}
+
+/*
+  Creates a list holding one node, or returns NULL on error.
+*/
+static struct ordmain_sg_node *
+make_list(void) {
+  struct root * const root = make_root();
+  if (NULL == root) {
+    return NULL;
+  }
+  struct ordmain_sg_node * const ans = alloc_node(root);
+  if (NULL == ans) {
+    destroy_root(root);
+    return NULL;
+  }
+  root->largest = 1;
+  root->first = ans;
+  ans->root = root;
+  ans->tag = 0;
+  ans->left = NULL;
+  ans->right = NULL;
+  ans->elevation = ceiling-1;
+  ans->deleted = false;
+  ans->epoch = root->epoch;
+  return ans;
+}
+
+struct ordmain_sg_node *
+ordmain_sg_insert_after(struct ordmain_sg_node * x) {
+  check_until(x);
+  if (NULL != x) {
+    assert (!x->deleted);
+    if (0 == x->elevation) {
+      // Only possible with about 2^(ceiling/2) nodes, by the balance
+      // condition
+      errno = ENOSPC;
+      return NULL;
+    }
+    struct ordmain_sg_node * ans = alloc_node(x->root);
+    if (NULL == ans) {
+      return NULL;
+    }
+
+    x->elevation -= 1;
+
+    const count_t mask = ((count_t)1) << x->elevation;
+
+    ans->deleted = false;
+    ans->tag = x->tag + mask;
+    ans->left = x;
+    ans->right = x->right;
+    ans->root = x->root;
+    ans->elevation = x->elevation;
+    ans->epoch = x->epoch;
+
+    x->right = ans;
+    if (NULL != ans->right) {
+      ans->right->left = ans;
+    }
+
+    x->root->largest += 1;
+    check_until(x);
+    maybe_rebalance(ans);
+    adapt(x->root, ans->elevation);
+    check_until(x);
+    sweep(x->root);
+    return ans;
+  } else {
+    return make_list();
+  }
+}
+
+struct ordmain_sg_node *
+ordmain_sg_insert_before(struct ordmain_sg_node * x) {
+  if (NULL == x) {
+    return make_list();
+  } else {
+    check_until(x);
+    assert (!x->deleted);
+    if (0 == x->elevation) {
+      errno = ENOSPC;
+      return NULL;
+    }
+    struct ordmain_sg_node * ans = alloc_node(x->root);
+    if (NULL == ans) {
+      return NULL;
+    }
+
+    x->elevation -= 1;
+
+    const count_t mask = ((count_t)1) << x->elevation;
+
+    ans->tag = x->tag;
+    x->tag += mask;
+    ans->right = x;
+    ans->left = x->left;
+    ans->root = x->root;
+    ans->elevation = x->elevation;
+    ans->deleted = false;
+    ans->epoch = x->epoch;
+
+    x->left = ans;
+    if (NULL != ans->left) {
+      ans->left->right = ans;
+    }
+    if (x == x->root->first) {
+      x->root->first = ans;
+    }
+    if (x == x->root->cursor) {
+      x->root->cursor = ans;
+    }
+
+    x->root->largest += 1;
+    check_until(ans);
+    maybe_rebalance(ans);
+    adapt(x->root, ans->elevation);
+    check_until(ans);
+    sweep(x->root);
+    return ans;
+  }
+}
+
+struct cleared {
+  struct ordmain_sg_node * left;
+  struct ordmain_sg_node * right;
+  count_t many;
+};
+
+/*
+  Detaches every deleted node in the list of x, which may itself be
+  deleted, and returns the first and last live nodes and how many
+  there are.
+*/
+static struct cleared
+clear(struct ordmain_sg_node * x) {
+  struct cleared ans = {NULL, NULL, 0};
+
+  // x may be detached below, so remember where the right half starts
+  struct ordmain_sg_node * const right_start = x->right;
+
+  while (NULL != x) {
+    if (x->deleted) {
+      struct ordmain_sg_node * newx = x->left;
+      detach(x);
+      x = newx;
+    } else {
+      ans.left = x;
+      if (NULL == ans.right) {
+	ans.right = x;
+      }
+      ++ans.many;
+      x = x->left;
+    }
+  }
+
+  assert(ans.right ? (ans.many > 0) : ((0 == ans.many) && (NULL == ans.left)));
+
+  x = right_start;
+
+  while (NULL != x) {
+    if (x->deleted) {
+      struct ordmain_sg_node * newx = x->right;
+      detach(x);
+      x = newx;
+    } else {
+      ++ans.many;
+      ans.right = x;
+      if (NULL == ans.left) {
+	ans.left = x;
+      }
+      x = x->right;
+    }
+  }
+
+  return ans;
+}
+
+/*
+  Rebuilds the whole list of x at once. This frees the root if every
+  node was deleted.
+*/
+static void
+rebuild(struct ordmain_sg_node * x) {
+  struct root * oldroot = x->root;
+  struct cleared fresh = clear(x);
+  if (0 == fresh.many) {
+    destroy_root(oldroot);
+  } else {
+    oldroot->first = fresh.left;
+    oldroot->cursor = NULL;
+    for (struct ordmain_sg_node * y = fresh.left; NULL != y; y = y->right) {
+      y->epoch = oldroot->epoch;
+    }
+    if (fresh.many > 1) {
+      fresh.left->tag = 0;
+      distribute(fresh.left, ceiling-1, fresh.many);
+    } else {
+      fresh.left->tag = 0;
+      fresh.left->elevation = ceiling-1;
+    }
+    fresh.left->root->largest = fresh.many;
+    fresh.left->root->deletes = 0;
+  }
+}
+
+void
+ordmain_sg_delete(struct ordmain_sg_node * x) {
+  check_until(x);
+  assert (!x->deleted);
+  struct root * const root = x->root;
+  x->deleted = true;
+  root->deletes += 1;
+  if (NULL == x->left
+      && NULL == x->right) {
+    destroy_root(root);
+    return;
+  }
+  if ((NULL == root->cursor) && ((root->deletes << 1) > root->largest)) {
+    if (root->largest < SYNC_REBUILD) {
+      STAT(++root->stats.rebuilds);
+      rebuild(x);
+      return;
+    }
+    begin_rebuild(root);
+  }
+  sweep(root);
+}
+
+void
+ordmain_sg_destroy_list(struct ordmain_sg_node * x) {
+  if (NULL != x) {
+    destroy_root(x->root);
+  }
+}
+
+int
+ordmain_sg_get_stats(const struct ordmain_sg_node * x, struct ordmain_sg_stats * out) {
+#ifdef ORDMAIN_STATS
+  if ((NULL == x) || (NULL == out)) {
+    errno = EINVAL;
+    return -1;
+  }
+  *out = x->root->stats;
+  return 0;
+#else
+  (void)x;
+  (void)out;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
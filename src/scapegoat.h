@@ -0,0 +1,90 @@
+#ifndef SCAPEGOAT_H
+#define SCAPEGOAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+An order maintenance list with 64-bit tags kept by partial rebuilding,
+as in a general balanced tree (Andersson 1989). Each tag is a path in
+an implicit binary tree, and when a path gets too long, the smallest
+enclosing subtree that is out of balance gets its tags spread out
+again, and any deleted nodes in it are freed. Other deleted nodes stay
+in place until half the list is deleted, and then the whole list is
+rebuilt.
+
+Build scapegoat.c with ORDMAIN_SG_WIDE_TAGS defined to use 128-bit
+tags instead, which needs a compiler with unsigned __int128. Lists can
+then grow to about 2^64 nodes, and skewed inserts take much longer to
+run out of tag bits.
+
+This is a separate backend from the one in order_maintenance.h. The
+two kinds of node cannot be mixed.
+*/
+
+/*
+opaque
+*/
+struct ordmain_sg_node;
+
+/*
+Returns true when x precedes y in the list.
+*/
+bool ordmain_sg_in_order(const struct ordmain_sg_node * x,
+                         const struct ordmain_sg_node * y);
+
+/*
+Returns a pointer to a newly created node placed just after x. If x
+is NULL, creates a list with a single node, then returns a pointer to
+that node. Returns NULL on error, with errno set to ENOMEM, or to
+ENOSPC if the list has too many nodes for its tags.
+*/
+struct ordmain_sg_node *
+ordmain_sg_insert_after(struct ordmain_sg_node * x);
+
+/*
+See ordmain_sg_insert_after.
+*/
+struct ordmain_sg_node *
+ordmain_sg_insert_before(struct ordmain_sg_node * x);
+
+/*
+Removes the node x from the list it belongs to. x must not be used
+again.
+*/
+void ordmain_sg_delete(struct ordmain_sg_node * x);
+
+/*
+Frees every node in the list that x belongs to, including x. Does
+nothing if x is NULL.
+*/
+void ordmain_sg_destroy_list(struct ordmain_sg_node * x);
+
+/*
+Counters kept per list when scapegoat.c is built with ORDMAIN_STATS
+defined. Without it, the counters are not compiled in at all.
+*/
+struct ordmain_sg_stats {
+  uint64_t inserts;
+  /* Nodes given new tags by rebalancing */
+  uint64_t relabeled;
+  /* Global rebuilds, for deletes or for a change of depth bound */
+  uint64_t rebuilds;
+  uint64_t slop_changes;
+  /* The current depth bound: a subtree of n nodes may be as deep as
+     slop/4 * log_2 n. */
+  unsigned slop;
+  /* The fewest free bits any inserted node's tag has had. An insert
+     fails with ENOSPC at 0. */
+  unsigned min_elevation;
+};
+
+/*
+Copies the counters of the list x belongs to into *out and returns 0.
+Returns -1 and sets errno to ENOSYS if scapegoat.c was built without
+ORDMAIN_STATS, or to EINVAL if x or out is NULL.
+*/
+int ordmain_sg_get_stats(const struct ordmain_sg_node * x,
+                         struct ordmain_sg_stats * out);
+
+#endif /* SCAPEGOAT_H */
@@ -12,9 +12,23 @@ using namespace boost;
 
 #include "lib/dart_order.hpp"
 extern "C" {
+#ifdef CO_SCAPEGOAT
+#include "scapegoat.h"
+#else
 #include "order_maintenance.h"
+#endif
 }
 
+// Built by co_sg.exe with CO_SCAPEGOAT defined: the same test against
+// the scapegoat backend. OM(f) names the backend's ordmain_f.
+#ifdef CO_SCAPEGOAT
+typedef ordmain_sg_node node_t;
+#define OM(f) ordmain_sg_ ## f
+#else
+typedef ordmain_node node_t;
+#define OM(f) ordmain_ ## f
+#endif
+
 optional<unsigned> parse_input(int argc, char * argv[]) {
   assert (argc > 0); // Otherwise this program has no name
   const optional<unsigned> nothing;
@@ -23,7 +37,7 @@ optional<unsigned> parse_input(int argc, char * argv[]) {
   }
   try {
     return lexical_cast<unsigned>(argv[1]);
-  } catch (bad_lexical_cast) {
+  } catch (const bad_lexical_cast &) {
     return nothing;
   }
 }
@@ -77,13 +91,13 @@ int main(int argc, char * argv[]) {
   cerr << "seed: " << seed << endl;
   
 
-  typedef dart_order<int,ordmain_node *> dart_t;
+  typedef dart_order<int,node_t *> dart_t;
   dart_t a;
   while (a.size() < size) {
     const int toinsert = rand();
     //cerr << "to insert: " << toinsert << endl;
     const dart_t::iterator place = 
-      a.insert(make_pair(toinsert,reinterpret_cast<ordmain_node*>(NULL)));
+      a.insert(make_pair(toinsert,reinterpret_cast<node_t*>(NULL)));
     if (place == a.end()) {
       continue; // value was already in dartboard
     }
@@ -91,21 +105,21 @@ int main(int argc, char * argv[]) {
 	dart_t::iterator after_place = place;
 	++after_place;
       if (after_place == a.end()) { // can't insert_before, this is the first item
-	place->second.val = ordmain_insert_after(NULL);
+	place->second.val = OM(insert_after)(NULL);
       } else {
-	ordmain_node * const after = after_place->second.val;
-	place->second.val = ordmain_insert_before(after);
+	node_t * const after = after_place->second.val;
+	place->second.val = OM(insert_before)(after);
       }
     } else {
       dart_t::iterator before_place = place;
       --before_place;
-      ordmain_node * const before = before_place->second.val;;
-      place->second.val = ordmain_insert_after(before);
+      node_t * const before = before_place->second.val;;
+      place->second.val = OM(insert_after)(before);
     }
 
     while ((a.size() > 0) && (0 == rand() % 2)) {
       dart_t::iterator p = a.get_random(rand);
-      ordmain_delete(p->second.val);
+      OM(delete)(p->second.val);
       a.erase(p);
     }
     
@@ -118,16 +132,29 @@ int main(int argc, char * argv[]) {
     
     //cerr << "to order: " << p->first << ' ' << q->first << endl;
 
-    ordmain_node * debugp = p->second.val;
-    ordmain_node * debugq = q->second.val;
-
     //cerr << boolalpha
     //<< (p->first < q->first) << endl
     //<< ordmain_in_order(p->second, q->second) << endl;
 
     assert ((p->first < q->first) ==
-	    (ordmain_in_order(p->second.val, q->second.val)));
+	    (OM(in_order)(p->second.val, q->second.val)));
+
+#ifdef ORDMAIN_RANK
+    // Built by co_rank.exe: ranks are positions in the map.
+    const dart_t & c = a;
+    const ptrdiff_t pr = std::distance(c.begin(), p);
+    const ptrdiff_t qr = std::distance(c.begin(), q);
+    size_t rank;
+    ptrdiff_t dist;
+    assert (0 == ordmain_rank(p->second.val, &rank));
+    assert (pr == static_cast<ptrdiff_t>(rank));
+    assert (0 == ordmain_distance(p->second.val, q->second.val, &dist));
+    assert (qr - pr == dist);
+#endif
 
+  }
 
+  if (a.size() > 0) {
+    OM(destroy_list)(a.begin()->second.val);
   }
 }
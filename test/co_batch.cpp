@@ -0,0 +1,138 @@
+// Tests ordmain_in_order_batch against ordmain_in_order, with
+// baseamort.c built to use the batch kernel named by
+// ORDMAIN_BATCH_KERNEL, avx2, sse or scalar, whatever the CPU would
+// pick. The Makefile builds one test for each kernel and tag width.
+// Each batch mixes pairs from one list, pairs of the same node, pairs
+// from two lists and pairs with NULL, and batches of every length up to
+// a few groups are tried, so that the kernels' tails are covered too.
+// If the CPU lacks the instructions of the kernel, the test is skipped.
+// Built with ORDMAIN_STATS, it also checks that each batch counts its
+// queries against the list of each xs[i].
+
+#include <cassert>
+#include <cstdlib>
+#include <ctime>
+
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+extern "C" {
+#include "order_maintenance.h"
+}
+
+#define NAMED(k) #k
+#define NAME(k) NAMED(k)
+
+typedef vector<const ordmain_node *> nodes;
+
+// Can this CPU run the kernel this was built with?
+static bool supported(const string & kernel) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  if ("avx2" == kernel) {
+    return __builtin_cpu_supports("avx2");
+  }
+  if ("sse" == kernel) {
+#ifdef ORDMAIN_WIDE_TAGS
+    return __builtin_cpu_supports("sse4.2");
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+  }
+#endif
+  return "scalar" == kernel;
+}
+
+// A node of the list v most of the time, and otherwise one of other or
+// NULL
+static const ordmain_node * pick(const nodes & v, const nodes & other) {
+  const int r = rand() % 16;
+  if (r < 14) {
+    return v[rand() % v.size()];
+  } else if (r < 15) {
+    return other[rand() % other.size()];
+  }
+  return NULL;
+}
+
+#ifdef ORDMAIN_STATS
+static uint64_t queries(const ordmain_node * const x) {
+  ordmain_stats s;
+  assert (0 == ordmain_get_stats(x, &s));
+  return s.queries;
+}
+#endif
+
+// Checks one batch of n random pairs
+static void check(const nodes & v, const nodes & other, const size_t n) {
+  nodes xs(n + 1), ys(n + 1);
+  for (size_t i = 0; i < n; ++i) {
+    xs[i] = pick(v, other);
+    ys[i] = (0 == rand() % 8) ? xs[i] : pick(v, other);
+  }
+  // out[n] is past what the call may write
+  vector<uint8_t> out(n + 1, 2);
+#ifdef ORDMAIN_STATS
+  const uint64_t v_before = queries(v[0]);
+  const uint64_t other_before = queries(other[0]);
+  ordmain_in_order_batch(&xs[0], &ys[0], n, &out[0]);
+  uint64_t in_other = 0, in_v = 0;
+  for (size_t i = 0; i < n; ++i) {
+    in_other += (other[0] == xs[i]);
+    in_v += (NULL != xs[i]) && (other[0] != xs[i]);
+  }
+  assert (v_before + in_v == queries(v[0]));
+  assert (other_before + in_other == queries(other[0]));
+#else
+  ordmain_in_order_batch(&xs[0], &ys[0], n, &out[0]);
+#endif
+  for (size_t i = 0; i < n; ++i) {
+    assert (out[i] == ordmain_in_order(xs[i], ys[i]));
+  }
+  assert (2 == out[n]);
+}
+
+int main(int argc, char * argv[]) {
+  if (argc < 2) {
+    cerr << "ERROR" << endl
+	 << "USAGE: " << argv[0] << " SIZE" << endl
+	 << "SIZE is the number of nodes to test with" << endl;
+    return 1;
+  }
+  const size_t size = strtoul(argv[1], NULL, 10);
+
+  const string kernel = NAME(ORDMAIN_BATCH_KERNEL);
+  if (!supported(kernel)) {
+    cerr << "skipped: this CPU cannot run the " << kernel << " kernel"
+         << endl;
+    return 0;
+  }
+
+  const time_t seed = time(NULL);
+  srand(seed);
+  cerr << "seed: " << seed << endl;
+
+  // Inserts at random and always at the front, so that the list is
+  // relabeled and its tags span the whole range
+  vector<ordmain_node *> grown(1, ordmain_insert_after(NULL));
+  while (grown.size() < size) {
+    ordmain_node * const x =
+      (0 == rand() % 2) ? grown[0] : grown[rand() % grown.size()];
+    grown.push_back(ordmain_insert_after(x));
+  }
+  const nodes v(grown.begin(), grown.end());
+  ordmain_node * const first = ordmain_insert_after(NULL);
+  const nodes other(1, ordmain_insert_after(first));
+
+  for (size_t n = 0; n <= 64; ++n) {
+    check(v, other, n);
+  }
+  for (int k = 0; k < 100; ++k) {
+    check(v, other, rand() % 1000);
+  }
+
+  ordmain_destroy_list(first);
+  ordmain_destroy_list(grown[0]);
+}
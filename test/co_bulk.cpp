@@ -0,0 +1,226 @@
+// Tests the calls of baseamort.c that work on many nodes at once
+// against a vector of the nodes in list order: ordmain_insert_n_after
+// puts runs of nodes after random nodes and again and again after the
+// same node, so that they relabel, and mixes in single inserts and
+// deletes. ordmain_build makes a list that then gets single inserts
+// and deletes of its own. ordmain_sort must put shuffled nodes back in
+// list order. Each call must leave every node where the vector says,
+// and a call that fails must leave every tag, or every entry of the
+// array it was given, as it was.
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <ctime>
+
+#include <iostream>
+#include <vector>
+using namespace std;
+
+extern "C" {
+#include "order_maintenance.h"
+}
+
+typedef vector<ordmain_node *> nodes;
+
+// Compares a few random pairs of v
+static void check(const nodes & v) {
+  for (int k = 0; k < 4; ++k) {
+    const size_t i = rand() % v.size();
+    const size_t j = rand() % v.size();
+    assert (ordmain_in_order(v[i], v[j]) == (i < j));
+  }
+}
+
+// Compares every pair of neighbors in v
+static void check_all(const nodes & v) {
+  for (size_t i = 1; i < v.size(); ++i) {
+    assert (ordmain_in_order(v[i-1], v[i]));
+    assert (!ordmain_in_order(v[i], v[i-1]));
+  }
+}
+
+// The tags of the nodes of v, to check that a failed call changed none
+static vector<unsigned long long> tags(const nodes & v) {
+  vector<unsigned long long> ans(v.size());
+  for (size_t i = 0; i < v.size(); ++i) {
+    ans[i] = v[i]->tag;
+  }
+  return ans;
+}
+
+// Puts n new nodes just after v[i], in v and in the list
+static void insert_n(nodes & v, const size_t i, const size_t n) {
+  nodes out(n + 1, NULL);
+  assert (0 == ordmain_insert_n_after(v[i], n, &out[0]));
+  // out[n] is past what the call may write
+  assert (NULL == out[n]);
+  v.insert(v.begin() + i + 1, out.begin(), out.begin() + n);
+}
+
+static void test_insert_n(const size_t size) {
+  // Nothing to insert, and no list to insert it in
+  ordmain_node * none = NULL;
+  assert (0 == ordmain_insert_n_after(NULL, 0, &none));
+  assert (NULL == none);
+
+  // A new list
+  nodes v(1 + rand() % 8);
+  assert (0 == ordmain_insert_n_after(NULL, v.size(), &v[0]));
+  check_all(v);
+
+  while (v.size() < size) {
+    const size_t n = rand() % 40;
+    const int pattern = rand() % 4;
+    if (0 == pattern) {
+      insert_n(v, rand() % v.size(), n);
+    } else if (1 == pattern) {
+      // The same place every time, so its gap runs out
+      insert_n(v, 0, n);
+    } else if (2 == pattern) {
+      insert_n(v, v.size() / 2, n);
+    } else {
+      const size_t i = rand() % v.size();
+      v.insert(v.begin() + i + 1, ordmain_insert_after(v[i]));
+    }
+    if ((v.size() > 1) && (0 == rand() % 3)) {
+      const size_t i = rand() % v.size();
+      ordmain_delete(v[i]);
+      v.erase(v.begin() + i);
+    }
+    check(v);
+  }
+  check_all(v);
+
+  // Too many nodes for the tags to hold
+  const vector<unsigned long long> before = tags(v);
+#ifdef ORDMAIN_WIDE_TAGS
+  const size_t too_many = (size_t)1 << 32;
+  errno = 0;
+  assert (-1 == ordmain_insert_n_after(v[0], too_many, NULL));
+#else
+  const size_t too_many = (size_t)1 << 16;
+  nodes out(too_many, NULL);
+  errno = 0;
+  assert (-1 == ordmain_insert_n_after(v[0], too_many, &out[0]));
+  assert (NULL == out[0]);
+#endif
+  assert (ENOSPC == errno);
+  assert (before == tags(v));
+  check_all(v);
+
+  ordmain_destroy_list(v[0]);
+}
+
+static void test_build(const size_t size) {
+  // No place to put the nodes
+  errno = 0;
+  assert (-1 == ordmain_build(size, NULL));
+  assert (EINVAL == errno);
+
+  ordmain_node * none = NULL;
+  assert (0 == ordmain_build(0, &none));
+  assert (NULL == none);
+
+#ifndef ORDMAIN_WIDE_TAGS
+  {
+    nodes out((size_t)1 << 16, NULL);
+    errno = 0;
+    assert (-1 == ordmain_build(out.size(), &out[0]));
+    assert (ENOSPC == errno);
+    assert (NULL == out[0]);
+  }
+#endif
+
+  nodes v(size);
+  assert (0 == ordmain_build(size, &v[0]));
+  check_all(v);
+
+  // The built list must take inserts and deletes like any other
+  for (size_t k = 0; k < size; ++k) {
+    const size_t i = rand() % v.size();
+    if (0 == rand() % 2) {
+      v.insert(v.begin() + i + 1, ordmain_insert_after(v[i]));
+    } else if (0 == rand() % 2) {
+      v.insert(v.begin() + i, ordmain_insert_before(v[i]));
+    } else if (v.size() > 1) {
+      ordmain_delete(v[i]);
+      v.erase(v.begin() + i);
+    }
+    check(v);
+  }
+  check_all(v);
+  ordmain_destroy_list(v[0]);
+}
+
+// Shuffles w with rand(), so that the seed printed repeats the run
+static void shuffle(nodes & w) {
+  for (size_t i = w.size(); i > 1; --i) {
+    swap(w[i - 1], w[rand() % i]);
+  }
+}
+
+// Sorts a shuffled copy of the first n nodes of v
+static void sort_shuffled(const nodes & v, const size_t n) {
+  nodes w(v.begin(), v.begin() + n);
+  shuffle(w);
+  assert (0 == ordmain_sort(&w[0], n));
+  assert (equal(w.begin(), w.end(), v.begin()));
+}
+
+static void test_sort(const size_t size) {
+  // Nothing to sort
+  assert (0 == ordmain_sort(NULL, 0));
+
+  nodes v(size);
+  assert (0 == ordmain_insert_n_after(NULL, size, &v[0]));
+  // Random inserts, so that the tags are not evenly spread
+  for (size_t k = 0; k < size; ++k) {
+    const size_t i = rand() % v.size();
+    v.insert(v.begin() + i + 1, ordmain_insert_after(v[i]));
+  }
+
+  // Small sorts and large ones take different paths
+  for (size_t n = 1; n <= 100 && n <= v.size(); ++n) {
+    sort_shuffled(v, n);
+  }
+  for (int k = 0; k < 4; ++k) {
+    sort_shuffled(v, 1 + rand() % v.size());
+  }
+  sort_shuffled(v, v.size());
+
+  // A node of another list, or no node at all, and the array must
+  // come back as it was
+  ordmain_node * const other = ordmain_insert_after(NULL);
+  for (int k = 0; k < 2; ++k) {
+    nodes w(v);
+    shuffle(w);
+    w[rand() % w.size()] = (0 == k) ? other : NULL;
+    const nodes before(w);
+    errno = 0;
+    assert (-1 == ordmain_sort(&w[0], w.size()));
+    assert (EINVAL == errno);
+    assert (before == w);
+  }
+  ordmain_destroy_list(other);
+  ordmain_destroy_list(v[0]);
+}
+
+int main(int argc, char * argv[]) {
+  if (argc < 2) {
+    cerr << "ERROR" << endl
+	 << "USAGE: " << argv[0] << " SIZE" << endl
+	 << "SIZE is the number of nodes to test with" << endl;
+    return 1;
+  }
+  const size_t size = strtoul(argv[1], NULL, 10);
+
+  const time_t seed = time(NULL);
+  srand(seed);
+  cerr << "seed: " << seed << endl;
+
+  test_insert_n(size);
+  test_build(size);
+  test_sort(size);
+}
@@ -0,0 +1,119 @@
+// Tests dsamort.c against baseamort.c: both lists get the same inserts
+// and deletes, and must agree with each other, and with the positions
+// of the nodes, on every order query. Inserts go after random nodes,
+// after the node inserted last, and repeatedly before one node, so
+// that sublists split both evenly and at their ends, and the list is
+// then deleted down to nothing to exercise merges.
+// co_ds_deamortized.exe builds dsamort.c with ORDMAIN_DS_DEAMORTIZED
+// and ORDMAIN_STATS, and also checks after every operation that none
+// has relabeled more than a bounded number of slots per level, and
+// that the levels stay within what the number of sublists allows.
+
+#include <cassert>
+#include <cstdlib>
+#include <ctime>
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+#include <vector>
+using namespace std;
+
+extern "C" {
+#include "order_maintenance.h"
+#include "dsamort.h"
+}
+
+// The nodes of both lists, in list order
+typedef vector<pair<ordmain_node *, ordmain_ds_node *> > lists;
+
+static void check(const lists & v) {
+  for (int k = 0; k < 4; ++k) {
+    const size_t i = rand() % v.size();
+    const size_t j = rand() % v.size();
+    const bool base = ordmain_in_order(v[i].first, v[j].first);
+    assert (base == (i < j));
+    assert (base == ordmain_ds_in_order(v[i].second, v[j].second));
+  }
+}
+
+#ifdef ORDMAIN_DS_DEAMORTIZED
+// The most levels the list has had
+static unsigned levels = 0;
+
+// An operation splits or merges at most one block per level, which
+// gives at most 2 * 64 slots new tags there, and every block but the
+// root holds at least 16 slots, so neither bound grows with the list
+static void bounded(const lists & v) {
+  ordmain_ds_stats s;
+  assert (0 == ordmain_ds_get_stats(v[0].second, &s));
+  assert (s.levels <= 8);
+  assert ((0 == s.levels) || ((2u << (4 * (s.levels - 1))) <= s.sublists));
+  levels = max(levels, s.levels);
+  assert (s.max_steps <= 2 * 64 * (levels + 1));
+}
+#else
+static void bounded(const lists &) {
+}
+#endif
+
+static void insert(lists & v, const size_t i, const bool after) {
+  const size_t at = after ? i + 1 : i;
+  ordmain_node * const a = after ? ordmain_insert_after(v[i].first)
+    : ordmain_insert_before(v[i].first);
+  ordmain_ds_node * const d = after ? ordmain_ds_insert_after(v[i].second)
+    : ordmain_ds_insert_before(v[i].second);
+  assert (NULL != a);
+  assert (NULL != d);
+  v.insert(v.begin() + at, make_pair(a, d));
+}
+
+static void erase(lists & v, const size_t i) {
+  ordmain_delete(v[i].first);
+  ordmain_ds_delete(v[i].second);
+  v.erase(v.begin() + i);
+}
+
+int main(int argc, char * argv[]) {
+  if (argc < 2) {
+    cerr << "ERROR" << endl
+	 << "USAGE: " << argv[0] << " SIZE" << endl
+	 << "SIZE is the number of inputs to test" << endl;
+    return 1;
+  }
+  const size_t size = strtoul(argv[1], NULL, 10);
+
+  const time_t seed = time(NULL);
+  srand(seed);
+  cerr << "seed: " << seed << endl;
+
+  lists v;
+  v.push_back(make_pair(ordmain_insert_after(NULL),
+                        ordmain_ds_insert_after(NULL)));
+  size_t last = 0;
+  while (v.size() < size) {
+    const int pattern = rand() % 3;
+    for (int k = 0; k < 64 && v.size() < size; ++k) {
+      if (0 == pattern) {
+        insert(v, rand() % v.size(), 0 != rand() % 2);
+      } else if (1 == pattern) {
+        last = (last < v.size()) ? last : v.size() - 1;
+        insert(v, last, true);
+        ++last;
+      } else {
+        insert(v, v.size() / 3, false);
+      }
+      if ((v.size() > 1) && (0 == rand() % 3)) {
+        erase(v, rand() % v.size());
+      }
+      check(v);
+      bounded(v);
+    }
+  }
+  while (v.size() > 1) {
+    erase(v, rand() % v.size());
+    check(v);
+    bounded(v);
+  }
+  erase(v, 0);
+}
@@ -0,0 +1,117 @@
+// Tests ordmain::list against a std::map of random keys, the way co.cpp
+// tests baseamort.c, for several tag widths and allocators.
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+using namespace std;
+
+#include "order_maintenance.hpp"
+
+template<typename L>
+void check(L & l, const unsigned size) {
+  typedef typename L::handle handle;
+  // Keys in order. The handles are the values, so erasing a key
+  // erases its node.
+  map<int, handle> a;
+  // The keys, for picking one at random
+  vector<int> keys;
+
+  while (a.size() < size && a.size() < L::max_nodes) {
+    const int toinsert = rand();
+    if (a.count(toinsert) > 0) {
+      continue;
+    }
+    const typename map<int, handle>::iterator after =
+      a.lower_bound(toinsert);
+    handle h = (after == a.end())
+      ? l.push_back()
+      : l.insert_before(*after->second);
+    a.emplace(toinsert, move(h));
+    keys.push_back(toinsert);
+
+    while ((keys.size() > 0) && (0 == rand() % 2)) {
+      const size_t i = rand() % keys.size();
+      a.erase(keys[i]);
+      keys[i] = keys.back();
+      keys.pop_back();
+    }
+    assert (a.size() == l.size());
+
+    if (0 == a.size()) {
+      continue;
+    }
+    const int p = keys[rand() % keys.size()];
+    const int q = keys[rand() % keys.size()];
+    assert ((p < q) == L::in_order(a.find(p)->second, a.find(q)->second));
+  }
+
+  // The iterators visit the nodes in the same order as the map, both
+  // ways.
+  typename L::const_iterator i = l.begin();
+  for (typename map<int, handle>::const_iterator j = a.begin();
+       j != a.end(); ++j, ++i) {
+    assert (&*i == j->second.get());
+  }
+  assert (i == l.end());
+  typename map<int, handle>::const_reverse_iterator j = a.rbegin();
+  for (i = l.end(); i != l.begin(); ++j) {
+    --i;
+    assert (&*i == j->second.get());
+  }
+
+  // Moving a list keeps its handles valid.
+  L m(move(l));
+  assert (m.size() == a.size());
+  if ((a.size() > 0) && (a.size() < L::max_nodes)) {
+    const handle & first = a.begin()->second;
+    handle h = m.insert_after(*first);
+    assert (L::in_order(first, h));
+    const typename L::node * const x = h.release();
+    m.erase(x);
+  }
+  a.clear();
+  assert (m.empty());
+  l = move(m);
+}
+
+int main(int argc, char * argv[]) {
+  if (argc < 2) {
+    cerr << "ERROR" << endl
+	 << "USAGE: " << argv[0] << " SIZE" << endl
+	 << "SIZE is the number of inputs to test" << endl;
+    return 1;
+  }
+  const unsigned size = strtoul(argv[1], NULL, 10);
+
+  const time_t seed = time(NULL);
+  srand(seed);
+  cerr << "seed: " << seed << endl;
+
+  {
+    // Small tags fill up, so relabels grow backward to the base often.
+    ordmain::list<uint16_t> l;
+    check(l, size);
+  }
+  {
+    ordmain::list<uint32_t> l;
+    check(l, size);
+  }
+  {
+    ordmain::list<> l;
+    check(l, size);
+  }
+  {
+    pmr::unsynchronized_pool_resource pool;
+    ordmain::pmr::list<> l(&pool);
+    check(l, size);
+  }
+}
@@ -0,0 +1,136 @@
+// Measures how order queries scale with reader threads while one
+// writer thread inserts and deletes, with the library built with
+// ORDMAIN_CONCURRENT. For comparison, it also runs the same workload
+// with every call wrapped in a pthread reader-writer lock.
+//
+// USAGE: concurrent_bench.exe [SIZE [MAX_READERS [SECONDS]]]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+using namespace std;
+
+#include <pthread.h>
+
+extern "C" {
+#include "order_maintenance.h"
+}
+
+// Nodes the readers query, in list order. The writer never deletes
+// them.
+static vector<ordmain_node *> stable;
+static atomic<bool> stop;
+// Queries that got the wrong answer
+static atomic<unsigned long> wrong;
+static pthread_rwlock_t lock = PTHREAD_RWLOCK_INITIALIZER;
+
+template<bool LOCKED>
+static void writer(atomic<unsigned long> * const ops, const unsigned seed) {
+  mt19937 gen(seed);
+  // The writer's own nodes, which it deletes again to keep the list
+  // from growing without bound
+  vector<ordmain_node *> mine;
+  unsigned long count = 0;
+  while (not stop.load(memory_order_relaxed)) {
+    if (LOCKED) {
+      pthread_rwlock_wrlock(&lock);
+    }
+    if (mine.size() < stable.size() && (gen() % 3 != 0 || mine.empty())) {
+      ordmain_node * const x = stable[gen() % stable.size()];
+      ordmain_node * const h = ordmain_insert_after(x);
+      if (NULL == h) {
+        abort();
+      }
+      mine.push_back(h);
+    } else {
+      const size_t i = gen() % mine.size();
+      ordmain_delete(mine[i]);
+      mine[i] = mine.back();
+      mine.pop_back();
+    }
+    if (LOCKED) {
+      pthread_rwlock_unlock(&lock);
+    }
+    ++count;
+  }
+  for (size_t i = 0; i < mine.size(); ++i) {
+    ordmain_delete(mine[i]);
+  }
+  ops->store(count);
+}
+
+template<bool LOCKED>
+static void reader(atomic<unsigned long> * const ops, const unsigned seed) {
+  mt19937 gen(seed);
+  unsigned long count = 0;
+  unsigned long bad = 0;
+  while (not stop.load(memory_order_relaxed)) {
+    // Check the clock flag only every so often
+    for (unsigned k = 0; k < 256; ++k) {
+      const size_t i = gen() % stable.size();
+      const size_t j = gen() % stable.size();
+      if (LOCKED) {
+        pthread_rwlock_rdlock(&lock);
+      }
+      bad += (ordmain_in_order(stable[i], stable[j]) != (i < j));
+      if (LOCKED) {
+        pthread_rwlock_unlock(&lock);
+      }
+    }
+    count += 256;
+  }
+  wrong += bad;
+  ops->store(count);
+}
+
+template<bool LOCKED>
+static void run(const unsigned readers, const double seconds) {
+  vector<atomic<unsigned long> > ops(readers + 1);
+  stop.store(false);
+  vector<thread> threads;
+  threads.emplace_back(writer<LOCKED>, &ops[0], 1);
+  for (unsigned r = 0; r < readers; ++r) {
+    threads.emplace_back(reader<LOCKED>, &ops[r + 1], r + 2);
+  }
+  this_thread::sleep_for(chrono::duration<double>(seconds));
+  stop.store(true);
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  unsigned long queries = 0;
+  for (unsigned r = 1; r <= readers; ++r) {
+    queries += ops[r].load();
+  }
+  printf("%-8s readers %2u  queries %8.2f M/s (%6.2f M/s each)  "
+         "updates %6.2f M/s\n",
+         LOCKED ? "rwlock" : "seqlock", readers,
+         queries / seconds / 1e6, queries / seconds / 1e6 / readers,
+         ops[0].load() / seconds / 1e6);
+}
+
+int main(int argc, char * argv[]) {
+  const size_t size = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10000;
+  const unsigned hw = thread::hardware_concurrency();
+  const unsigned max_readers = (argc > 2) ? strtoul(argv[2], NULL, 10)
+    : ((hw > 1) ? hw - 1 : 1);
+  const double seconds = (argc > 3) ? strtod(argv[3], NULL) : 1.0;
+
+  stable.resize(size);
+  if (0 != ordmain_build(size, stable.data())) {
+    perror("ordmain_build");
+    return 1;
+  }
+  for (unsigned r = 1; r <= max_readers; r *= 2) {
+    run<false>(r, seconds);
+    run<true>(r, seconds);
+  }
+  ordmain_destroy_list(stable[0]);
+  if (0 != wrong.load()) {
+    fprintf(stderr, "%lu wrong answers\n", wrong.load());
+    return 1;
+  }
+}
@@ -0,0 +1,140 @@
+// Compares dsamort.c with baseamort.c, built with ORDMAIN_WIDE_TAGS,
+// on the patterns of sg_bench.cpp: inserts after the node inserted
+// last, after a node picked at random, and always after the same node,
+// then as many order queries between random nodes. For each it prints
+// the time and the relabels per insert, and the most relabels any one
+// insert did. For dsamort, those count the nodes and the sublists
+// relabeled. Each insert is timed on its own, so that the tail of the
+// latencies can be printed too. ds_bench_deamortized.exe builds
+// dsamort.c with ORDMAIN_DS_DEAMORTIZED.
+//
+// USAGE: ds_bench.exe [INSERTS [SEED]]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+using namespace std;
+
+extern "C" {
+#include "order_maintenance.h"
+#include "dsamort.h"
+}
+
+enum pattern { SEQUENTIAL, RANDOM, HOTSPOT };
+
+static const char * const names[] = {"sequential", "random", "hotspot"};
+
+// The calls and counters of one backend
+struct baseamort {
+  typedef ordmain_node node;
+  static const char * name() { return "baseamort"; }
+  static node * insert_after(node * x) { return ordmain_insert_after(x); }
+  static bool in_order(const node * x, const node * y) {
+    return ordmain_in_order(x, y);
+  }
+  static void destroy_list(node * x) { ordmain_destroy_list(x); }
+  static pair<double, unsigned long> relabels(const node * x) {
+    ordmain_stats s;
+    if (0 != ordmain_get_stats(x, &s)) {
+      perror("ordmain_get_stats");
+      exit(1);
+    }
+    return make_pair((double)s.relabeled, (unsigned long)s.max_relabel);
+  }
+};
+
+struct dsamort {
+  typedef ordmain_ds_node node;
+  static const char * name() { return "dsamort"; }
+  static node * insert_after(node * x) { return ordmain_ds_insert_after(x); }
+  static bool in_order(const node * x, const node * y) {
+    return ordmain_ds_in_order(x, y);
+  }
+  static void destroy_list(node * x) { ordmain_ds_destroy_list(x); }
+  static pair<double, unsigned long> relabels(const node * x) {
+    ordmain_ds_stats s;
+    if (0 != ordmain_ds_get_stats(x, &s)) {
+      perror("ordmain_ds_get_stats");
+      exit(1);
+    }
+    return make_pair((double)(s.relabeled + s.top_relabeled),
+                     (unsigned long)s.max_steps);
+  }
+};
+
+// The latency that a fraction q of the sorted latencies are below, in ns
+static double quantile(const vector<double> & sorted, const double q) {
+  return sorted[min(sorted.size() - 1, (size_t)(q * sorted.size()))] * 1e9;
+}
+
+template<typename B>
+static void run(const pattern p, const size_t inserts, const unsigned seed) {
+  typedef typename B::node node;
+  mt19937 gen(seed);
+  vector<node *> nodes;
+  nodes.reserve(inserts + 1);
+  nodes.push_back(B::insert_after(NULL));
+  if (NULL == nodes[0]) {
+    perror("insert_after");
+    exit(1);
+  }
+  vector<double> latencies(inserts);
+  double seconds = 0;
+  for (size_t i = 0; i < inserts; ++i) {
+    node * x = nodes[0];
+    if (SEQUENTIAL == p) {
+      x = nodes.back();
+    } else if (RANDOM == p) {
+      x = nodes[gen() % nodes.size()];
+    }
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    node * const h = B::insert_after(x);
+    latencies[i] = chrono::duration<double>(
+      chrono::steady_clock::now() - start).count();
+    seconds += latencies[i];
+    if (NULL == h) {
+      perror("insert_after");
+      exit(1);
+    }
+    nodes.push_back(h);
+  }
+  sort(latencies.begin(), latencies.end());
+
+  // Pick the pairs first, so that only the queries are timed
+  vector<pair<node *, node *> > pairs(inserts);
+  for (size_t i = 0; i < inserts; ++i) {
+    pairs[i].first = nodes[gen() % nodes.size()];
+    pairs[i].second = nodes[gen() % nodes.size()];
+  }
+  size_t before = 0;
+  const chrono::steady_clock::time_point asked = chrono::steady_clock::now();
+  for (size_t i = 0; i < inserts; ++i) {
+    before += B::in_order(pairs[i].first, pairs[i].second);
+  }
+  const double query_seconds = chrono::duration<double>(
+    chrono::steady_clock::now() - asked).count();
+
+  const pair<double, unsigned long> relabels = B::relabels(nodes[0]);
+  printf("%-10s %-10s  %7.1f ns/insert  relabeled %6.2f/insert  "
+         "max %6lu  %5.1f ns/query (%zu before)\n",
+         B::name(), names[p], seconds * 1e9 / inserts,
+         relabels.first / inserts, relabels.second,
+         query_seconds * 1e9 / inserts, before);
+  printf("%-10s %-10s  p99.9 %7.0f ns  p99.99 %7.0f ns  max %9.0f ns\n",
+         B::name(), names[p], quantile(latencies, 0.999),
+         quantile(latencies, 0.9999), latencies.back() * 1e9);
+  B::destroy_list(nodes[0]);
+}
+
+int main(int argc, char * argv[]) {
+  const size_t inserts = (argc > 1) ? strtoul(argv[1], NULL, 10) : 500000;
+  const unsigned seed = (argc > 2) ? strtoul(argv[2], NULL, 10) : 1;
+  for (int p = SEQUENTIAL; p <= HOTSPOT; ++p) {
+    run<baseamort>(static_cast<pattern>(p), inserts, seed);
+    run<dsamort>(static_cast<pattern>(p), inserts, seed);
+  }
+}
@@ -0,0 +1,99 @@
+// Measures how dsamort.c scales with the size of the list. For each
+// size from a thousand up to MAX, by factors of ten, it builds a list
+// of that size by inserting after the node inserted last, after a node
+// picked at random, and always after the same node, as ds_bench.cpp
+// does, then times as many order queries between random nodes, up to
+// a million. For each it prints the time and the relabels per insert,
+// the most relabels any one insert did, the number of sublists, the
+// limit on their length that the list has grown to, and the levels of
+// blocks above them. ds_scale_deamortized.exe builds dsamort.c with
+// ORDMAIN_DS_DEAMORTIZED, whose most relabels per insert should stay
+// flat as the list grows.
+//
+// A list of a billion nodes takes about 70 GB, counting the fingers
+// kept here to pick nodes from.
+//
+// USAGE: ds_scale.exe [MAX [SEED]]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+using namespace std;
+
+extern "C" {
+#include "dsamort.h"
+}
+
+enum pattern { SEQUENTIAL, RANDOM, HOTSPOT };
+
+static const char * const names[] = {"sequential", "random", "hotspot"};
+
+static void run(const pattern p, const size_t size, const unsigned seed) {
+  mt19937_64 gen(seed);
+  vector<ordmain_ds_node *> nodes;
+  nodes.reserve(size);
+  nodes.push_back(ordmain_ds_insert_after(NULL));
+  if (NULL == nodes[0]) {
+    perror("ordmain_ds_insert_after");
+    exit(1);
+  }
+  const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  while (nodes.size() < size) {
+    ordmain_ds_node * x = nodes[0];
+    if (SEQUENTIAL == p) {
+      x = nodes.back();
+    } else if (RANDOM == p) {
+      x = nodes[gen() % nodes.size()];
+    }
+    ordmain_ds_node * const h = ordmain_ds_insert_after(x);
+    if (NULL == h) {
+      perror("ordmain_ds_insert_after");
+      exit(1);
+    }
+    nodes.push_back(h);
+  }
+  const double seconds = chrono::duration<double>(
+    chrono::steady_clock::now() - start).count();
+
+  const size_t queries = (size < 1000000) ? size : 1000000;
+  vector<pair<ordmain_ds_node *, ordmain_ds_node *> > pairs(queries);
+  for (size_t i = 0; i < queries; ++i) {
+    pairs[i].first = nodes[gen() % nodes.size()];
+    pairs[i].second = nodes[gen() % nodes.size()];
+  }
+  size_t before = 0;
+  const chrono::steady_clock::time_point asked = chrono::steady_clock::now();
+  for (size_t i = 0; i < queries; ++i) {
+    before += ordmain_ds_in_order(pairs[i].first, pairs[i].second);
+  }
+  const double query_seconds = chrono::duration<double>(
+    chrono::steady_clock::now() - asked).count();
+
+  ordmain_ds_stats stats;
+  if (0 != ordmain_ds_get_stats(nodes[0], &stats)) {
+    perror("ordmain_ds_get_stats");
+    exit(1);
+  }
+  const size_t inserts = size - 1;
+  printf("%12zu %-10s  %7.1f ns/insert  relabeled %6.2f/insert  "
+         "max %8lu  sublists %10u  limit %2u  levels %u  "
+         "%5.1f ns/query (%zu before)\n",
+         size, names[p], seconds * 1e9 / inserts,
+         (double)(stats.relabeled + stats.top_relabeled) / inserts,
+         (unsigned long)stats.max_steps, stats.sublists, stats.limit,
+         stats.levels, query_seconds * 1e9 / queries, before);
+  ordmain_ds_destroy_list(nodes[0]);
+}
+
+int main(int argc, char * argv[]) {
+  const size_t max = (argc > 1) ? strtoull(argv[1], NULL, 10) : 10000000;
+  const unsigned seed = (argc > 2) ? strtoul(argv[2], NULL, 10) : 1;
+  for (size_t size = 1000; size <= max; size *= 10) {
+    for (int p = SEQUENTIAL; p <= HOTSPOT; ++p) {
+      run(static_cast<pattern>(p), size, seed);
+    }
+  }
+}
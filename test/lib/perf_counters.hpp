@@ -0,0 +1,132 @@
+// Hardware event counters for a stretch of a benchmark, read through
+// Linux's perf_event_open: cycles, instructions, L1 data cache read
+// misses, last level cache read misses, data TLB read misses and branch
+// misses. Only user-mode events of the calling thread are counted.
+//
+// Each counter is opened on its own, so that one the machine or kernel
+// does not support leaves the others working. A counter that cannot be
+// opened, as in most containers and VMs without a PMU, or where
+// perf_event_paranoid forbids it, is reported as null. When the kernel
+// has to multiplex more counters than the PMU has, the counts are
+// scaled up by the fraction of the time each ran.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+class perf_counters {
+  enum { COUNTERS = 6 };
+
+  struct event {
+    const char * name;
+    uint32_t type;
+    uint64_t config;
+  };
+
+  static const event & events(const int i) {
+    static const event all[COUNTERS] = {
+      {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {"l1d_misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+       | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+       | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+      {"llc_misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL
+       | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+       | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+      {"dtlb_misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB
+       | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+       | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+      {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}
+    };
+    return all[i];
+  }
+
+  int fds[COUNTERS];
+  double counts[COUNTERS];
+
+public:
+  perf_counters() {
+    for (int i = 0; i < COUNTERS; ++i) {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = events(i).type;
+      attr.config = events(i).config;
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+        | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+      counts[i] = -1;
+    }
+  }
+
+  ~perf_counters() {
+    for (int i = 0; i < COUNTERS; ++i) {
+      if (fds[i] >= 0) {
+        close(fds[i]);
+      }
+    }
+  }
+
+  // Whether any counter could be opened
+  bool available() const {
+    for (int i = 0; i < COUNTERS; ++i) {
+      if (fds[i] >= 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Zeroes the counters and starts them
+  void start() {
+    for (int i = 0; i < COUNTERS; ++i) {
+      if (fds[i] >= 0) {
+        ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+  }
+
+  // Stops the counters and reads them
+  void stop() {
+    for (int i = 0; i < COUNTERS; ++i) {
+      if (fds[i] >= 0) {
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+      }
+    }
+    for (int i = 0; i < COUNTERS; ++i) {
+      // The count, the time enabled and the time running
+      uint64_t value[3];
+      if ((fds[i] < 0)
+          || (read(fds[i], value, sizeof(value)) != sizeof(value))) {
+        counts[i] = -1;
+      } else if (0 == value[2]) {
+        // Never got onto the PMU
+        counts[i] = (0 == value[1]) ? 0 : -1;
+      } else {
+        counts[i] = (double)value[0] * value[1] / value[2];
+      }
+    }
+  }
+
+  // Prints each count divided by ops as JSON members, each preceded by
+  // a comma, as in , "cycles_per_op": 123.4
+  void print_json(FILE * out, const double ops) const {
+    for (int i = 0; i < COUNTERS; ++i) {
+      if (counts[i] < 0) {
+        fprintf(out, ", \"%s_per_op\": null", events(i).name);
+      } else {
+        fprintf(out, ", \"%s_per_op\": %.3f", events(i).name,
+                counts[i] / ops);
+      }
+    }
+  }
+};
@@ -0,0 +1,134 @@
+// Generators of where to insert next, for benchmarks that grow a list
+// one node at a time. A generator sees the nodes as numbered in the
+// order they were created, 0 for the first, and for each insert picks
+// one of them and whether the new node goes just after or just before
+// it. Generators are seeded, so that the same seed gives the same
+// sequence of inserts on every machine.
+//
+//   append       after the node inserted last
+//   left_append  before the node inserted last, so that each new node
+//                becomes the first of the list
+//   random       after a node picked uniformly at random
+//   hotspot      after the first node, so that each new node squeezes
+//                into the same place
+//   sawtooth     teeth of WIDTH inserts: each starts after the first
+//                node and goes on after the node inserted last, so
+//                that each tooth splits the gap the last one filled
+//   zipfian      after a node picked with probability about
+//                proportional to 1 / (k + 1)^S, where k is its number,
+//                so that the oldest nodes get most of the inserts
+//
+// append and hotspot are the patterns that use up the local tag space
+// of baseamort.c fastest; uniform random inserts almost never do.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+
+namespace workload {
+
+// One insert: just after, or just before, node number at
+struct step {
+  size_t at;
+  bool before;
+};
+
+class generator {
+protected:
+  std::mt19937_64 gen;
+
+public:
+  explicit generator(const uint64_t seed) : gen(seed) {}
+  virtual ~generator() {}
+  // Where the next insert goes in a list of n > 0 nodes
+  virtual step next(size_t n) = 0;
+};
+
+class append : public generator {
+public:
+  explicit append(const uint64_t seed) : generator(seed) {}
+  step next(const size_t n) { return step{n - 1, false}; }
+};
+
+class left_append : public generator {
+public:
+  explicit left_append(const uint64_t seed) : generator(seed) {}
+  step next(const size_t n) { return step{n - 1, true}; }
+};
+
+class random : public generator {
+public:
+  explicit random(const uint64_t seed) : generator(seed) {}
+  step next(const size_t n) { return step{gen() % n, false}; }
+};
+
+class hotspot : public generator {
+public:
+  explicit hotspot(const uint64_t seed) : generator(seed) {}
+  step next(size_t) { return step{0, false}; }
+};
+
+class sawtooth : public generator {
+  const size_t width;
+  size_t done;
+
+public:
+  explicit sawtooth(const uint64_t seed, const size_t w = 64)
+    : generator(seed), width(w), done(0) {}
+  step next(const size_t n) {
+    const bool fresh = (0 == done % width);
+    ++done;
+    return step{fresh ? 0 : n - 1, false};
+  }
+};
+
+// Draws by inverting the continuous density proportional to x^-S on
+// [1, n + 1), which needs no table and so suits a list that grows with
+// every draw.
+class zipfian : public generator {
+  const double s;
+  std::uniform_real_distribution<double> unit;
+
+public:
+  explicit zipfian(const uint64_t seed, const double skew = 0.99)
+    : generator(seed), s(skew), unit(0, 1) {}
+  step next(const size_t n) {
+    const double u = unit(gen);
+    double x;
+    if (std::fabs(s - 1) < 1e-9) {
+      x = std::pow(n + 1.0, u);
+    } else {
+      const double e = 1 - s;
+      x = std::pow(1 + u * (std::pow(n + 1.0, e) - 1), 1 / e);
+    }
+    const size_t k = (size_t)x - 1;
+    return step{(k < n) ? k : n - 1, false};
+  }
+};
+
+// The names of the generators, in the order they are listed above
+static const char * const names[] = {
+  "append", "left_append", "random", "hotspot", "sawtooth", "zipfian"
+};
+
+// Returns a new generator, with its defaults, of the kind name names,
+// or NULL if there is none by that name
+inline generator * make(const char * const name, const uint64_t seed) {
+  if (0 == strcmp(name, "append")) {
+    return new append(seed);
+  } else if (0 == strcmp(name, "left_append")) {
+    return new left_append(seed);
+  } else if (0 == strcmp(name, "random")) {
+    return new random(seed);
+  } else if (0 == strcmp(name, "hotspot")) {
+    return new hotspot(seed);
+  } else if (0 == strcmp(name, "sawtooth")) {
+    return new sawtooth(seed);
+  } else if (0 == strcmp(name, "zipfian")) {
+    return new zipfian(seed);
+  }
+  return NULL;
+}
+
+} // namespace workload
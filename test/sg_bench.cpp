@@ -0,0 +1,97 @@
+// Measures what the depth bound of scapegoat.c costs: time and tags
+// moved per insert, against how close tags come to running out. It
+// inserts into one list in each of three patterns: after the node
+// inserted last, after a node picked at random, and always after the
+// same node, then times as many order queries between random nodes.
+// sg_bench.exe uses the adaptive bound, sg_bench_fixed.exe builds
+// scapegoat.c with ORDMAIN_SG_SLOP=8 to fix it at twice the logarithm,
+// and sg_bench_wide.exe builds it with ORDMAIN_SG_WIDE_TAGS.
+//
+// USAGE: sg_bench.exe [INSERTS [SEED]]
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+using namespace std;
+
+extern "C" {
+#include "scapegoat.h"
+}
+
+enum pattern { SEQUENTIAL, RANDOM, HOTSPOT };
+
+static const char * const names[] = {"sequential", "random", "hotspot"};
+
+static void run(const pattern p, const size_t inserts, const unsigned seed) {
+  mt19937 gen(seed);
+  vector<ordmain_sg_node *> nodes;
+  nodes.reserve(inserts + 1);
+  nodes.push_back(ordmain_sg_insert_after(NULL));
+  if (NULL == nodes[0]) {
+    perror("ordmain_sg_insert_after");
+    exit(1);
+  }
+  size_t full = 0;
+  const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (size_t i = 0; i < inserts; ++i) {
+    ordmain_sg_node * x = nodes[0];
+    if (SEQUENTIAL == p) {
+      x = nodes.back();
+    } else if (RANDOM == p) {
+      x = nodes[gen() % nodes.size()];
+    }
+    ordmain_sg_node * const h = ordmain_sg_insert_after(x);
+    if (NULL == h) {
+      if (ENOSPC != errno) {
+        perror("ordmain_sg_insert_after");
+        exit(1);
+      }
+      ++full;
+      continue;
+    }
+    nodes.push_back(h);
+  }
+  const double seconds = chrono::duration<double>(
+    chrono::steady_clock::now() - start).count();
+
+  // Pick the pairs first, so that only the queries are timed
+  vector<pair<ordmain_sg_node *, ordmain_sg_node *> > pairs(inserts);
+  for (size_t i = 0; i < inserts; ++i) {
+    pairs[i].first = nodes[gen() % nodes.size()];
+    pairs[i].second = nodes[gen() % nodes.size()];
+  }
+  size_t before = 0;
+  const chrono::steady_clock::time_point asked = chrono::steady_clock::now();
+  for (size_t i = 0; i < inserts; ++i) {
+    before += ordmain_sg_in_order(pairs[i].first, pairs[i].second);
+  }
+  const double query_seconds = chrono::duration<double>(
+    chrono::steady_clock::now() - asked).count();
+
+  ordmain_sg_stats stats;
+  if (0 != ordmain_sg_get_stats(nodes[0], &stats)) {
+    perror("ordmain_sg_get_stats");
+    exit(1);
+  }
+  printf("%-10s  %7.1f ns/insert  moved %6.2f/insert  "
+         "rebuilds %3lu  slop %2u/4 (%lu changes)  min elevation %3u  "
+         "full %zu  %5.1f ns/query (%zu before)\n",
+         names[p], seconds * 1e9 / inserts,
+         (double)stats.relabeled / inserts,
+         (unsigned long)stats.rebuilds, stats.slop,
+         (unsigned long)stats.slop_changes, stats.min_elevation, full,
+         query_seconds * 1e9 / inserts, before);
+  ordmain_sg_destroy_list(nodes[0]);
+}
+
+int main(int argc, char * argv[]) {
+  const size_t inserts = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+  const unsigned seed = (argc > 2) ? strtoul(argv[2], NULL, 10) : 1;
+  run(SEQUENTIAL, inserts, seed);
+  run(RANDOM, inserts, seed);
+  run(HOTSPOT, inserts, seed);
+}
@@ -0,0 +1,80 @@
+// Compares ordmain_sort with std::sort using ordmain_in_order as the
+// comparison, on lists of a million nodes up to MAX by factors of ten.
+// Each list is grown by inserts after random nodes, so that the nodes
+// are spread over memory and the tags are not evenly spaced, and then
+// all of its nodes are sorted from a random order. For each size it
+// prints the time per node of each sort and how many times faster
+// ordmain_sort was.
+//
+// baseamort.c is built with ORDMAIN_WIDE_TAGS, so that a list can hold
+// 10^8 nodes. At that size ordmain_sort needs 3.2 GB for its buffer on
+// top of the list and the arrays.
+//
+// USAGE: sort_bench.exe [MAX [SEED]]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+using namespace std;
+
+extern "C" {
+#include "order_maintenance.h"
+}
+
+typedef vector<ordmain_node *> nodes;
+
+// Seconds that f() took
+template<typename F>
+static double timed(F f) {
+  const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  f();
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char * argv[]) {
+  const size_t max = (argc > 1) ? strtoull(argv[1], NULL, 10) : 10000000;
+  const unsigned seed = (argc > 2) ? strtoul(argv[2], NULL, 10) : 1;
+  mt19937_64 gen(seed);
+
+  printf("%12s %12s %12s %8s\n", "nodes", "radix ns", "std ns", "speedup");
+  for (size_t size = 1000000; size <= max; size *= 10) {
+    nodes v;
+    v.reserve(size);
+    v.push_back(ordmain_insert_after(NULL));
+    while (v.size() < size) {
+      ordmain_node * const h = ordmain_insert_after(v[gen() % v.size()]);
+      if (NULL == h) {
+        perror("ordmain_insert_after");
+        return 1;
+      }
+      v.push_back(h);
+    }
+    shuffle(v.begin(), v.end(), gen);
+
+    nodes radix(v);
+    const double r = timed([&]() {
+        if (0 != ordmain_sort(&radix[0], radix.size())) {
+          perror("ordmain_sort");
+          exit(1);
+        }
+      });
+    nodes by_compare(v);
+    const double s = timed([&]() {
+        sort(by_compare.begin(), by_compare.end(),
+             [](const ordmain_node * x, const ordmain_node * y) {
+               return ordmain_in_order(x, y);
+             });
+      });
+    if (radix != by_compare) {
+      fputs("the sorts disagree\n", stderr);
+      return 1;
+    }
+    printf("%12zu %12.1f %12.1f %8.1f\n", size, r * 1e9 / size,
+           s * 1e9 / size, s / r);
+    fflush(stdout);
+    ordmain_destroy_list(v[0]);
+  }
+}
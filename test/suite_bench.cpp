@@ -0,0 +1,352 @@
+// Runs each backend, baseamort.c, scapegoat.c and dsamort.c, through a
+// set of named workloads, at sizes from a thousand up to MAX by factors
+// of ten, and writes the results to stdout as a JSON array with one
+// object per run:
+//
+//   append, left_append, random, hotspot, sawtooth, zipfian
+//                n inserts, each where the generator of that name in
+//                lib/workload.hpp puts it
+//   churn        on a list of n nodes built by random inserts, n
+//                operations that alternately delete a random node and
+//                insert after one
+//   query        on such a list, n operations, nine in ten of them
+//                order queries between random nodes and the rest
+//                random inserts
+//   bulk_delete  on such a list, deletes all but one node in random
+//                order
+//
+// Only the n operations are timed, each on its own, so the latencies
+// include the cost of reading the clock once. For each run it reports
+// the mean time per operation, existing nodes relabeled per operation,
+// the 50th, 99th and 99.9th percentile and the largest latency, inserts
+// that failed, and the peak resident memory. Each run is done in a
+// child process, so that its peak memory is its own.
+//
+// Around the timed operations it also reads the hardware counters of
+// lib/perf_counters.hpp, and reports each per operation, or null where
+// the counter is not available. They count the reads of the clock
+// too, which come to a few dozen instructions per operation.
+//
+// baseamort.c and scapegoat.c are built with wide tags, so that none of
+// the three runs out of tags first.
+//
+// USAGE: suite_bench.exe [MAX [SEED]]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <vector>
+using namespace std;
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern "C" {
+#include "order_maintenance.h"
+#include "scapegoat.h"
+#include "dsamort.h"
+}
+
+#include "lib/perf_counters.hpp"
+#include "lib/workload.hpp"
+
+// The calls and counters of each backend
+
+struct baseamort {
+  typedef ordmain_node node;
+  static const char * name() { return "baseamort"; }
+  static node * insert_after(node * x) { return ordmain_insert_after(x); }
+  static node * insert_before(node * x) { return ordmain_insert_before(x); }
+  static void erase(node * x) { ordmain_delete(x); }
+  static bool in_order(const node * x, const node * y) {
+    return ordmain_in_order(x, y);
+  }
+  static void destroy_list(node * x) { ordmain_destroy_list(x); }
+  static uint64_t relabeled(const node * x) {
+    ordmain_stats s;
+    if (0 != ordmain_get_stats(x, &s)) {
+      perror("ordmain_get_stats");
+      exit(1);
+    }
+    return s.relabeled;
+  }
+};
+
+struct scapegoat {
+  typedef ordmain_sg_node node;
+  static const char * name() { return "scapegoat"; }
+  static node * insert_after(node * x) { return ordmain_sg_insert_after(x); }
+  static node * insert_before(node * x) {
+    return ordmain_sg_insert_before(x);
+  }
+  static void erase(node * x) { ordmain_sg_delete(x); }
+  static bool in_order(const node * x, const node * y) {
+    return ordmain_sg_in_order(x, y);
+  }
+  static void destroy_list(node * x) { ordmain_sg_destroy_list(x); }
+  static uint64_t relabeled(const node * x) {
+    ordmain_sg_stats s;
+    if (0 != ordmain_sg_get_stats(x, &s)) {
+      perror("ordmain_sg_get_stats");
+      exit(1);
+    }
+    return s.relabeled;
+  }
+};
+
+struct dsamort {
+  typedef ordmain_ds_node node;
+  static const char * name() { return "dsamort"; }
+  static node * insert_after(node * x) { return ordmain_ds_insert_after(x); }
+  static node * insert_before(node * x) {
+    return ordmain_ds_insert_before(x);
+  }
+  static void erase(node * x) { ordmain_ds_delete(x); }
+  static bool in_order(const node * x, const node * y) {
+    return ordmain_ds_in_order(x, y);
+  }
+  static void destroy_list(node * x) { ordmain_ds_destroy_list(x); }
+  static uint64_t relabeled(const node * x) {
+    ordmain_ds_stats s;
+    if (0 != ordmain_ds_get_stats(x, &s)) {
+      perror("ordmain_ds_get_stats");
+      exit(1);
+    }
+    return s.relabeled + s.top_relabeled;
+  }
+};
+
+// Latencies in nanoseconds, counted in buckets about 3% wide, so that
+// a run of 10^8 operations does not need to keep each one. Values below
+// 64 get a bucket each, and each power of two above that is cut into
+// 32 buckets.
+class histogram {
+  vector<uint64_t> counts;
+  uint64_t total;
+
+  static size_t bucket(const uint64_t ns) {
+    if (ns < 64) {
+      return ns;
+    }
+    unsigned b = 6;
+    while ((ns >> b) > 1) {
+      ++b;
+    }
+    const unsigned shift = b - 5;
+    return 64 + (b - 6) * 32 + ((ns >> shift) - 32);
+  }
+
+  // The least value that goes in bucket i
+  static uint64_t floor(const size_t i) {
+    if (i < 64) {
+      return i;
+    }
+    const unsigned shift = 1 + (i - 64) / 32;
+    return (32 + (i - 64) % 32) << shift;
+  }
+
+public:
+  histogram() : counts(64 + 32 * 58, 0), total(0) {}
+
+  void add(const uint64_t ns) {
+    ++counts[bucket(ns)];
+    ++total;
+  }
+
+  // The least latency that at least a fraction q of all are at or below
+  uint64_t quantile(const double q) const {
+    const uint64_t want = (uint64_t)(q * total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+      seen += counts[i];
+      if ((seen > want) || (seen == total)) {
+        return floor(i);
+      }
+    }
+    return 0;
+  }
+};
+
+// The workloads other than those of lib/workload.hpp
+static const char * const mixed[] = {"churn", "query", "bulk_delete"};
+
+// What one run measured
+struct result {
+  size_t ops;
+  size_t failed;
+  double seconds;
+  uint64_t relabeled;
+  histogram latencies;
+  uint64_t max_ns;
+  perf_counters hardware;
+};
+
+// Times one operation, op(), adding its latency to r
+template<typename F>
+static void timed(result & r, F op) {
+  const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  op();
+  const chrono::steady_clock::duration took =
+    chrono::steady_clock::now() - start;
+  const uint64_t ns = chrono::duration_cast<chrono::nanoseconds>(took).count();
+  r.latencies.add(ns);
+  r.max_ns = max(r.max_ns, ns);
+  r.seconds += chrono::duration<double>(took).count();
+  ++r.ops;
+}
+
+template<typename B>
+static void run(const char * const w, const size_t size,
+                const unsigned seed, result & r) {
+  typedef typename B::node node;
+  mt19937_64 gen(seed);
+  vector<node *> nodes;
+  nodes.reserve(size + 1);
+  nodes.push_back(B::insert_after(NULL));
+  if (NULL == nodes[0]) {
+    perror("insert_after");
+    exit(1);
+  }
+  // Inserts after, or before, x, keeping the new node unless it failed
+  const auto insert = [&](node * const x, const bool before = false) {
+    node * const h = before ? B::insert_before(x) : B::insert_after(x);
+    if (NULL == h) {
+      ++r.failed;
+    } else {
+      nodes.push_back(h);
+    }
+  };
+  const auto any = [&]() { return nodes[gen() % nodes.size()]; };
+
+  workload::generator * const where = workload::make(w, seed);
+  if (NULL != where) {
+    const uint64_t before = B::relabeled(nodes[0]);
+    r.hardware.start();
+    for (size_t i = 1; i < size; ++i) {
+      const workload::step next = where->next(nodes.size());
+      node * const x = nodes[next.at];
+      timed(r, [&]() { insert(x, next.before); });
+    }
+    r.hardware.stop();
+    r.relabeled = B::relabeled(nodes[0]) - before;
+    B::destroy_list(nodes[0]);
+    delete where;
+    return;
+  }
+
+  while (nodes.size() < size) {
+    insert(any());
+  }
+  r.failed = 0;
+  const uint64_t before = B::relabeled(nodes[0]);
+  r.hardware.start();
+  if (0 == strcmp(w, "churn")) {
+    for (size_t i = 0; i < size; ++i) {
+      if ((0 == i % 2) && (nodes.size() > 1)) {
+        // Never delete the first node, which is kept to read the
+        // counters from
+        const size_t k = 1 + gen() % (nodes.size() - 1);
+        node * const x = nodes[k];
+        nodes[k] = nodes.back();
+        nodes.pop_back();
+        timed(r, [&]() { B::erase(x); });
+      } else {
+        node * const x = any();
+        timed(r, [&]() { insert(x); });
+      }
+    }
+  } else if (0 == strcmp(w, "query")) {
+    size_t found = 0;
+    for (size_t i = 0; i < size; ++i) {
+      if (0 == i % 10) {
+        node * const x = any();
+        timed(r, [&]() { insert(x); });
+      } else {
+        node * const x = any();
+        node * const y = any();
+        timed(r, [&]() { found += B::in_order(x, y); });
+      }
+    }
+    // Keeps the queries from being optimized away
+    if (found > size) {
+      fputs("impossible\n", stderr);
+    }
+  } else {
+    shuffle(nodes.begin() + 1, nodes.end(), gen);
+    while (nodes.size() > 1) {
+      node * const x = nodes.back();
+      nodes.pop_back();
+      timed(r, [&]() { B::erase(x); });
+    }
+  }
+  r.hardware.stop();
+  r.relabeled = B::relabeled(nodes[0]) - before;
+  B::destroy_list(nodes[0]);
+}
+
+// Runs one backend on one workload in a child process, which prints
+// the result as a JSON object
+template<typename B>
+static void report(const char * const w, const size_t size,
+                   const unsigned seed, const bool first) {
+  fflush(stdout);
+  const pid_t child = fork();
+  if (child < 0) {
+    perror("fork");
+    exit(1);
+  }
+  if (0 == child) {
+    result r;
+    r.ops = r.failed = 0;
+    r.seconds = 0;
+    r.relabeled = r.max_ns = 0;
+    run<B>(w, size, seed, r);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    const double ops = (0 == r.ops) ? 1 : r.ops;
+    printf("%s  {\"engine\": \"%s\", \"workload\": \"%s\", \"size\": %zu, "
+           "\"ops\": %zu, \"failed\": %zu, \"ns_per_op\": %.1f, "
+           "\"relabeled_per_op\": %.3f, \"p50_ns\": %llu, \"p99_ns\": %llu, "
+           "\"p999_ns\": %llu, \"max_ns\": %llu, \"peak_rss_kb\": %ld",
+           first ? "" : ",\n", B::name(), w, size, r.ops, r.failed,
+           r.seconds * 1e9 / ops, r.relabeled / ops,
+           (unsigned long long)r.latencies.quantile(0.5),
+           (unsigned long long)r.latencies.quantile(0.99),
+           (unsigned long long)r.latencies.quantile(0.999),
+           (unsigned long long)r.max_ns, usage.ru_maxrss);
+    r.hardware.print_json(stdout, ops);
+    putchar('}');
+    fflush(stdout);
+    _exit(0);
+  }
+  int status;
+  if ((waitpid(child, &status, 0) < 0) || !WIFEXITED(status)
+      || (0 != WEXITSTATUS(status))) {
+    fprintf(stderr, "%s %s %zu failed\n", B::name(), w, size);
+    exit(1);
+  }
+}
+
+int main(int argc, char * argv[]) {
+  const size_t max = (argc > 1) ? strtoull(argv[1], NULL, 10) : 1000000;
+  const unsigned seed = (argc > 2) ? strtoul(argv[2], NULL, 10) : 1;
+  puts("[");
+  bool first = true;
+  for (size_t size = 1000; size <= max; size *= 10) {
+    vector<const char *> all(begin(workload::names), end(workload::names));
+    all.insert(all.end(), begin(mixed), end(mixed));
+    for (const char * const w : all) {
+      report<baseamort>(w, size, seed, first);
+      report<scapegoat>(w, size, seed, false);
+      report<dsamort>(w, size, seed, false);
+      first = false;
+    }
+  }
+  puts("\n]");
+}
@@ -0,0 +1,111 @@
+// Compares the two tag widths of baseamort.c on the patterns of
+// sg_bench.cpp: inserts after the node inserted last, after a node
+// picked at random, and always after the same node, then as many order
+// queries between random nodes. For each it prints the time and the
+// existing nodes relabeled per insert, the most relabeled by any one
+// insert, and how many inserts were skipped because the list was full.
+// tag_bench.exe builds baseamort.c with 32-bit tags, and
+// tag_bench_wide.exe with ORDMAIN_WIDE_TAGS; run both with the same
+// arguments to compare them. ordmain_insert_after does not check that
+// a 32-bit list has room, so that build stops at 2^16 - 2 nodes, and
+// the inserts past that count as full.
+//
+// USAGE: tag_bench.exe [INSERTS [SEED]]
+
+#include <cerrno>
+#include <cstdint>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+using namespace std;
+
+extern "C" {
+#include "order_maintenance.h"
+}
+
+enum pattern { SEQUENTIAL, RANDOM, HOTSPOT };
+
+static const char * const names[] = {"sequential", "random", "hotspot"};
+
+#ifdef ORDMAIN_WIDE_TAGS
+static const int tag_bits = 64;
+static const size_t max_nodes = SIZE_MAX;
+#else
+static const int tag_bits = 32;
+static const size_t max_nodes = (1 << 16) - 2;
+#endif
+
+static void run(const pattern p, const size_t inserts, const unsigned seed) {
+  mt19937 gen(seed);
+  vector<ordmain_node *> nodes;
+  nodes.reserve(inserts + 1);
+  nodes.push_back(ordmain_insert_after(NULL));
+  if (NULL == nodes[0]) {
+    perror("ordmain_insert_after");
+    exit(1);
+  }
+  size_t full = 0;
+  const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (size_t i = 0; i < inserts; ++i) {
+    if (nodes.size() >= max_nodes) {
+      ++full;
+      continue;
+    }
+    ordmain_node * x = nodes[0];
+    if (SEQUENTIAL == p) {
+      x = nodes.back();
+    } else if (RANDOM == p) {
+      x = nodes[gen() % nodes.size()];
+    }
+    ordmain_node * const h = ordmain_insert_after(x);
+    if (NULL == h) {
+      if (ENOSPC != errno) {
+        perror("ordmain_insert_after");
+        exit(1);
+      }
+      ++full;
+      continue;
+    }
+    nodes.push_back(h);
+  }
+  const double seconds = chrono::duration<double>(
+    chrono::steady_clock::now() - start).count();
+
+  // Pick the pairs first, so that only the queries are timed
+  vector<pair<ordmain_node *, ordmain_node *> > pairs(inserts);
+  for (size_t i = 0; i < inserts; ++i) {
+    pairs[i].first = nodes[gen() % nodes.size()];
+    pairs[i].second = nodes[gen() % nodes.size()];
+  }
+  size_t before = 0;
+  const chrono::steady_clock::time_point asked = chrono::steady_clock::now();
+  for (size_t i = 0; i < inserts; ++i) {
+    before += ordmain_in_order(pairs[i].first, pairs[i].second);
+  }
+  const double query_seconds = chrono::duration<double>(
+    chrono::steady_clock::now() - asked).count();
+
+  ordmain_stats stats;
+  if (0 != ordmain_get_stats(nodes[0], &stats)) {
+    perror("ordmain_get_stats");
+    exit(1);
+  }
+  printf("%-10s  %d-bit tags  %7.1f ns/insert  relabeled %7.2f/insert  "
+         "max %8lu  full %zu  %5.1f ns/query (%zu before)\n",
+         names[p], tag_bits, seconds * 1e9 / inserts,
+         (double)stats.relabeled / inserts,
+         (unsigned long)stats.max_relabel, full,
+         query_seconds * 1e9 / inserts, before);
+  ordmain_destroy_list(nodes[0]);
+}
+
+int main(int argc, char * argv[]) {
+  const size_t inserts = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+  const unsigned seed = (argc > 2) ? strtoul(argv[2], NULL, 10) : 1;
+  run(SEQUENTIAL, inserts, seed);
+  run(RANDOM, inserts, seed);
+  run(HOTSPOT, inserts, seed);
+}